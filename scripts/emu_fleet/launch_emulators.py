@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Spawns several independent emulated devices, each in its own process with its own
+# instance directory (eeprom.bin, dbflash.bin, smartcard.bin) and HID socket name
+import subprocess
+import argparse
+import signal
+import time
+import sys
+import os
+
+
+def build_command(args, index):
+	instance_dir = os.path.abspath(os.path.join(args.base_dir, "device_%d" % index))
+	smartcard = os.path.join(instance_dir, "smartcard.bin")
+	if not os.path.isdir(instance_dir):
+		os.makedirs(instance_dir)
+
+	command = [args.emulator,
+		"--instance-dir", instance_dir,
+		"--hid-socket", "%s_%d" % (args.socket_prefix, index)]
+
+	# Keep the card between runs, create a blank one the first time
+	if os.path.exists(smartcard):
+		command += ["--smartcard", smartcard]
+	elif not args.no_smartcard:
+		command += ["--new-smartcard", smartcard]
+
+	if args.bundle:
+		command += ["--bundle", os.path.abspath(args.bundle)]
+	if args.speed != 1:
+		command += ["--speed", str(args.speed)]
+	if args.virtual_time:
+		command += ["--virtual-time"]
+	if args.control_prefix:
+		command += ["--control-socket", "%s_%d" % (args.control_prefix, index)]
+
+	return instance_dir, command
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Launch several emulated Mini BLE devices")
+	parser.add_argument("-n", "--count", type=int, default=4, help="number of devices")
+	parser.add_argument("--emulator", default="../../source_code/main_mcu/build/minible_headless", help="emulator binary, the headless one is recommended")
+	parser.add_argument("--base-dir", default="emu_fleet", help="directory holding one sub directory per device")
+	parser.add_argument("--bundle", help="bundle image, forwarded to the emulators")
+	parser.add_argument("--socket-prefix", default="moolticuted_local_dev", help="HID socket names are <prefix>_<index>")
+	parser.add_argument("--control-prefix", help="headless control socket names are <prefix>_<index>")
+	parser.add_argument("--speed", type=float, default=1, help="emulated time speed multiplier")
+	parser.add_argument("--virtual-time", action="store_true", help="skip firmware delays")
+	parser.add_argument("--no-smartcard", action="store_true", help="don't insert a blank card in new devices")
+	args = parser.parse_args()
+
+	processes = []
+	for index in range(args.count):
+		instance_dir, command = build_command(args, index)
+		log = open(os.path.join(instance_dir, "emulator.log"), "w")
+		processes.append(subprocess.Popen(command, stdin=subprocess.DEVNULL, stdout=log, stderr=subprocess.STDOUT))
+		print("Device %d: pid %d, socket %s_%d, files in %s" % (index, processes[-1].pid, args.socket_prefix, index, instance_dir))
+
+	# Run until interrupted or until all devices exited
+	try:
+		while any(process.poll() is None for process in processes):
+			time.sleep(0.5)
+	except KeyboardInterrupt:
+		print("Stopping devices")
+
+	# The flash files are memory mapped: the kernel writes them back even though the emulators are killed
+	for process in processes:
+		if process.poll() is None:
+			process.send_signal(signal.SIGTERM)
+	for process in processes:
+		try:
+			process.wait(10)
+		except subprocess.TimeoutExpired:
+			process.kill()
+
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
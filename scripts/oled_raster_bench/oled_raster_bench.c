@@ -0,0 +1,155 @@
+/*
+ * Host side micro benchmark of the OLED raster kernels (src/OLED/oled_raster.c)
+ * against the byte loops they replaced, run on the emulator SH1122 frame buffer.
+ * Also checks that both give the same frame buffer contents.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sh1122.h"
+#include "oled_raster.h"
+
+#define LINE_BYTES  (SH1122_OLED_WIDTH/2)
+
+static oled_descriptor_t oled_ref;
+static oled_descriptor_t oled_test;
+static volatile uint8_t sink;
+
+/* Reference implementations: newlib nano memcpy / memset & previous driver loops */
+static void ref_copy(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes)
+{
+    while (nb_bytes--)
+    {
+        *dst++ = *src++;
+    }
+}
+
+static uint8_t ref_copy_shifted(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes, uint8_t prev)
+{
+    while (nb_bytes--)
+    {
+        *dst++ = (uint8_t)((*src >> 4) | (prev << 4));
+        prev = *src++;
+    }
+    return prev;
+}
+
+static void ref_fill(uint8_t* dst, uint8_t pattern, uint16_t nb_bytes)
+{
+    while (nb_bytes--)
+    {
+        *dst++ = pattern;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void fill_random(uint8_t* buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        buf[i] = (uint8_t)rand();
+    }
+}
+
+static int check_kernels(void)
+{
+    uint8_t src[LINE_BYTES + 8];
+    int errors = 0;
+
+    for (int src_off = 0; src_off < 4; src_off++)
+    {
+        for (int dst_off = 0; dst_off < 8; dst_off++)
+        {
+            for (int len = 0; len <= LINE_BYTES - 8; len++)
+            {
+                fill_random(src, sizeof(src));
+                fill_random(&oled_ref.frame_buffer[0][0], sizeof(oled_ref.frame_buffer));
+                memcpy(oled_test.frame_buffer, oled_ref.frame_buffer, sizeof(oled_ref.frame_buffer));
+
+                ref_copy(&oled_ref.frame_buffer[0][dst_off], src + src_off, len);
+                oled_raster_copy(&oled_test.frame_buffer[0][dst_off], src + src_off, len);
+
+                uint8_t prev = (uint8_t)rand();
+                uint8_t ref_last = ref_copy_shifted(&oled_ref.frame_buffer[1][dst_off], src + src_off, len, prev);
+                uint8_t test_last = oled_raster_copy_shifted(&oled_test.frame_buffer[1][dst_off], src + src_off, len, prev);
+
+                ref_fill(&oled_ref.frame_buffer[2][dst_off], src[0], len);
+                oled_raster_fill(&oled_test.frame_buffer[2][dst_off], src[0], len);
+
+                if ((ref_last != test_last) || (memcmp(oled_ref.frame_buffer, oled_test.frame_buffer, sizeof(oled_ref.frame_buffer)) != 0))
+                {
+                    printf("Mismatch: src offset %d, dst offset %d, %d bytes\n", src_off, dst_off, len);
+                    errors++;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+typedef void (*bench_fn_t)(uint8_t* line, const uint8_t* src, int y);
+
+static void bench_ref_copy(uint8_t* line, const uint8_t* src, int y) { ref_copy(line, src, LINE_BYTES); }
+static void bench_copy(uint8_t* line, const uint8_t* src, int y) { oled_raster_copy(line, src, LINE_BYTES); }
+static void bench_ref_copy_unaligned(uint8_t* line, const uint8_t* src, int y) { ref_copy(line, src + 1, LINE_BYTES - 1); }
+static void bench_copy_unaligned(uint8_t* line, const uint8_t* src, int y) { oled_raster_copy(line, src + 1, LINE_BYTES - 1); }
+static void bench_ref_shifted(uint8_t* line, const uint8_t* src, int y) { sink = ref_copy_shifted(line, src, LINE_BYTES, 0); }
+static void bench_shifted(uint8_t* line, const uint8_t* src, int y) { sink = oled_raster_copy_shifted(line, src, LINE_BYTES, 0); }
+static void bench_ref_fill(uint8_t* line, const uint8_t* src, int y) { ref_fill(line, (uint8_t)y, LINE_BYTES); }
+static void bench_fill(uint8_t* line, const uint8_t* src, int y) { oled_raster_fill(line, (uint8_t)y, LINE_BYTES); }
+
+static double bench_frame(bench_fn_t fn, int nb_frames)
+{
+    uint8_t src[LINE_BYTES + 4];
+    fill_random(src, sizeof(src));
+
+    double start = now_ns();
+    for (int frame = 0; frame < nb_frames; frame++)
+    {
+        for (int y = 0; y < SH1122_OLED_HEIGHT; y++)
+        {
+            fn(&oled_test.frame_buffer[y][0], src, y);
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+    return (now_ns() - start) / nb_frames;
+}
+
+int main(int argc, char* argv[])
+{
+    int nb_frames = (argc > 1) ? atoi(argv[1]) : 20000;
+    struct
+    {
+        const char* name;
+        bench_fn_t ref;
+        bench_fn_t kernel;
+    } benches[] =
+    {
+        {"full screen aligned blit", bench_ref_copy, bench_copy},
+        {"full screen unaligned source blit", bench_ref_copy_unaligned, bench_copy_unaligned},
+        {"full screen odd x blit", bench_ref_shifted, bench_shifted},
+        {"full screen fill", bench_ref_fill, bench_fill},
+    };
+
+    srand(1234);
+    int errors = check_kernels();
+    printf("Kernel checks: %s\n\n", errors == 0 ? "OK" : "FAILED");
+
+    printf("%-36s %12s %12s %8s\n", "frame (256x64 4bpp)", "ref ns", "kernel ns", "speedup");
+    for (size_t i = 0; i < sizeof(benches)/sizeof(benches[0]); i++)
+    {
+        double ref_ns = bench_frame(benches[i].ref, nb_frames);
+        double kernel_ns = bench_frame(benches[i].kernel, nb_frames);
+        printf("%-36s %12.0f %12.0f %7.2fx\n", benches[i].name, ref_ns, kernel_ns, ref_ns / kernel_ns);
+    }
+
+    return errors == 0 ? 0 : 1;
+}
@@ -95,6 +95,7 @@ SOURCES += src/EMU/lis2hh12.c \
     src/LOGIC/logic_accelerometer.c \
     src/NODEMGMT/nodemgmt.c \
     src/OLED/mooltipass_graphics_bundle.c \
+    src/OLED/oled_raster.c \
     src/OLED/sh1122.c \
     src/EMU/platform_io.c \
     src/RNG/rng.c \
@@ -111,7 +112,10 @@ SOURCES += src/EMU/lis2hh12.c \
     src/EMU/emulator.cpp \
     src/EMU/emu_oled.cpp \
     src/EMU/emu_smartcard.cpp \
+    src/EMU/emu_hid_link.cpp \
     src/EMU/emu_storage.cpp \
+    src/EMU/emu_snapshot.cpp \
+    src/EMU/emu_replay.cpp \
     src/EMU/emulator_ui.cpp
 
 QMAKE_CXXFLAGS += -fdata-sections \
@@ -155,6 +159,14 @@ DEFINES += DESTDIR=""
 DEFINES += PREFIX="/usr"
 DEFINES += PLAT_V6_SETUP
 
+# qmake CONFIG+=headless: no widgets, the emulator is driven through stdin / a local socket
+headless {
+    QT -= gui widgets
+    TARGET = minible_emu_headless
+    DEFINES += EMULATOR_HEADLESS
+    SOURCES += src/EMU/emu_headless.cpp
+}
+
 HEADERS  += src/MainWindow.h \ \
     src/BearSSL/inc/bearssl.h \
     src/COMMS/comms_aux_mcu.h \
@@ -164,8 +176,12 @@ HEADERS  += src/MainWindow.h \ \
     src/COMMS/comms_hid_msgs_debug.h \
     src/EMU/asf.h \
     src/EMU/emu_aux_mcu.h \
+    src/EMU/emu_headless.h \
+    src/EMU/emu_hid_link.h \
     src/EMU/emu_oled.h \
+    src/EMU/emu_replay.h \
     src/EMU/emu_smartcard.h \
+    src/EMU/emu_snapshot.h \
     src/EMU/emu_storage.h \
     src/EMU/emulator.h \
     src/EMU/emulator_ui.h \
@@ -191,6 +207,7 @@ HEADERS  += src/MainWindow.h \ \
     src/LOGIC/logic_user.h \
     src/NODEMGMT/nodemgmt.h \
     src/OLED/mooltipass_graphics_bundle.h \
+    src/OLED/oled_raster.h \
     src/OLED/sh1122.h \
     src/RNG/rng.h \
     src/SE_SMARTCARD/smartcard_highlevel.h \
@@ -122,9 +122,17 @@
 #define HID_CMD_GET_CPZ_LUT_ENTRY   0x010E
 #define HID_CMD_GET_FAVORITES       0x010F
 #define HID_CMD_CHANGE_NODE_PWD     0x0110
+#define HID_CMD_READ_NODES          0x0111
+#define HID_CMD_WRITE_NODES         0x0112
+#define HID_CMD_GET_CHANGED_NODES   0x0113
+#define HID_CMD_GET_DB_TREE_HASHES  0x0114
+#define HID_CMD_IMPORT_CREDS        0x0115
 // Define used to identify commands
 #define HID_FIRST_CMD_FOR_MMM       HID_CMD_GET_START_PARENTS
 #define HID_LAST_CMD_FOR_MMM        0x0200
+// HID_CMD_GET_CHANGED_NODES answer status
+#define HID_CHANGED_NODES_JOURNAL_LOST  0
+#define HID_CHANGED_NODES_JOURNAL_OK    1
 
 /* Typedefs */
 typedef struct
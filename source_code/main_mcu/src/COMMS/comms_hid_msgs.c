@@ -204,6 +204,100 @@ void comms_hid_msgs_send_ack_nack_message(BOOL usb_hid_message, uint16_t message
     comms_aux_mcu_send_message(temp_tx_message_pt);
 }
 
+/*! \fn     comms_hid_msgs_check_store_cred_request(hid_message_store_cred_t* store_cred_pt, uint16_t max_cust_char_length, cust_char_t** field_pts)
+*   \brief  Sanity checks for a store credential request, and get pointers to its fields
+*   \param  store_cred_pt           Pointer to the store credential request
+*   \param  max_cust_char_length    Maximum number of cust_char_t in the concatenated strings
+*   \param  field_pts               Array of 5 pointers to be filled: service, login, description, third field & password (0 when not specified)
+*   \return success status
+*/
+static RET_TYPE comms_hid_msgs_check_store_cred_request(hid_message_store_cred_t* store_cred_pt, uint16_t max_cust_char_length, cust_char_t** field_pts)
+{
+    /* Incorrect service name index */
+    if (store_cred_pt->service_name_index != 0)
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Empty service name */
+    if ((max_cust_char_length == 0) || (store_cred_pt->concatenated_strings[0] == 0))
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Sequential order check */
+    uint16_t temp_length = 0;
+    uint16_t prev_length = 0;
+    uint16_t prev_check_index = 0;
+    uint16_t current_check_index = 0;
+    uint16_t check_indexes[5] = {   store_cred_pt->service_name_index, \
+                                    store_cred_pt->login_name_index, \
+                                    store_cred_pt->description_index, \
+                                    store_cred_pt->third_field_index, \
+                                    store_cred_pt->password_index};
+    
+    /* Check all fields */
+    for (uint16_t i = 0; i < ARRAY_SIZE(check_indexes); i++)
+    {
+        current_check_index = check_indexes[i];
+        
+        /* If index indicates present field */
+        if (current_check_index != UINT16_MAX)
+        {
+            /* If index is correct */
+            if (current_check_index != prev_check_index + prev_length)
+            {
+                return RETURN_NOK;
+            }
+            
+            /* Get string length */
+            temp_length = utils_strnlen(&(store_cred_pt->concatenated_strings[current_check_index]), max_cust_char_length);
+            
+            /* Too long length */
+            if (temp_length == max_cust_char_length)
+            {
+                return RETURN_NOK;
+            }
+            
+            /* Store previous index & length */
+            prev_length = temp_length + 1;
+            prev_check_index = current_check_index;
+            
+            /* Reduce max length */
+            max_cust_char_length -= (temp_length + 1);
+        }
+    }
+    
+    /* Dirty hack for fields not set */
+    uint16_t empty_string_index = utils_strlen(store_cred_pt->concatenated_strings);
+    if (store_cred_pt->login_name_index == UINT16_MAX)
+    {
+        store_cred_pt->login_name_index = empty_string_index;
+    }
+    
+    /* In case we only want to update certain fields */
+    for (uint16_t i = 0; i < ARRAY_SIZE(check_indexes); i++)
+    {
+        field_pts[i] = (cust_char_t*)0;
+    }
+    field_pts[0] = &(store_cred_pt->concatenated_strings[store_cred_pt->service_name_index]);
+    field_pts[1] = &(store_cred_pt->concatenated_strings[store_cred_pt->login_name_index]);
+    if (store_cred_pt->description_index != UINT16_MAX)
+    {
+        field_pts[2] = &(store_cred_pt->concatenated_strings[store_cred_pt->description_index]);
+    }
+    if (store_cred_pt->third_field_index != UINT16_MAX)
+    {
+        field_pts[3] = &(store_cred_pt->concatenated_strings[store_cred_pt->third_field_index]);
+    }
+    if (store_cred_pt->password_index != UINT16_MAX)
+    {
+        field_pts[4] = &(store_cred_pt->concatenated_strings[store_cred_pt->password_index]);
+    }
+    
+    return RETURN_OK;
+}
+
 /*! \fn     comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_length, msg_restrict_type_te answer_restrict_type, BOOL is_message_from_usb)
 *   \brief  Parse an incoming message from USB or BLE
 *   \param  rcv_msg                 Received message
@@ -783,6 +877,9 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             /* Check address length */
             if (rcv_msg->payload_length == 2*sizeof(uint16_t))
             {
+                /* Database externally changed: service index is rebuilt at next import or when leaving MMM */
+                nodemgmt_invalidate_service_index();
+                
                 /* Store new address */
                 nodemgmt_set_cred_start_address(rcv_msg->payload_as_uint16[1], rcv_msg->payload_as_uint16[0]);
 
@@ -803,6 +900,9 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             /* Check address length */
             if (rcv_msg->payload_length == 2*sizeof(uint16_t))
             {
+                /* Database externally changed: service index is rebuilt at next import or when leaving MMM */
+                nodemgmt_invalidate_service_index();
+                
                 /* Store new address */
                 nodemgmt_set_data_start_address(rcv_msg->payload_as_uint16[1], rcv_msg->payload_as_uint16[0]);
 
@@ -823,6 +923,9 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             /* Check address length */
             if (rcv_msg->payload_length == (MEMBER_SIZE(nodemgmt_profile_main_data_t, cred_start_addresses) + MEMBER_SIZE(nodemgmt_profile_main_data_t, data_start_addresses)))
             {
+                /* Database externally changed: service index is rebuilt at next import or when leaving MMM */
+                nodemgmt_invalidate_service_index();
+                
                 /* Store new addresses */
                 nodemgmt_set_start_addresses(rcv_msg->payload_as_uint16);
 
@@ -1030,6 +1133,71 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             }
         }
 
+        case HID_CMD_READ_NODES:
+        {
+            /* Check for at least one address */
+            if ((rcv_msg->payload_length >= sizeof(uint16_t)) && ((rcv_msg->payload_length % sizeof(uint16_t)) == 0))
+            {
+                aux_mcu_message_t* temp_tx_message_pt = comms_hid_msgs_get_empty_hid_packet(is_message_from_usb, rcv_message_type, 0);
+                uint16_t nb_addresses = rcv_msg->payload_length / sizeof(uint16_t);
+                uint16_t answer_length = 0;
+                
+                /* Answer: for each address, the address, the node length (0 if no permission) and the node. Stop when the next node doesn't fit */
+                for (uint16_t i = 0; i < nb_addresses; i++)
+                {
+                    uint16_t node_address = rcv_msg->payload_as_uint16[i];
+                    uint16_t node_length = 0;
+                    node_type_te temp_node_type;
+                    
+                    /* Check user permission */
+                    if (nodemgmt_check_user_permission(node_address, &temp_node_type) == RETURN_OK)
+                    {
+                        if ((temp_node_type == NODE_TYPE_PARENT) || (temp_node_type == NODE_TYPE_PARENT_DATA) || (temp_node_type == NODE_TYPE_NULL))
+                        {
+                            node_length = sizeof(parent_node_t);
+                        }
+                        else
+                        {
+                            node_length = sizeof(child_node_t);
+                        }
+                    }
+                    
+                    /* Check for space */
+                    if (answer_length + 2*sizeof(uint16_t) + node_length > max_payload_size)
+                    {
+                        break;
+                    }
+                    
+                    /* Store address & length */
+                    temp_tx_message_pt->hid_message.payload_as_uint16[answer_length/sizeof(uint16_t)] = node_address;
+                    temp_tx_message_pt->hid_message.payload_as_uint16[answer_length/sizeof(uint16_t) + 1] = node_length;
+                    answer_length += 2*sizeof(uint16_t);
+                    
+                    /* Read node */
+                    if (node_length == sizeof(parent_node_t))
+                    {
+                        nodemgmt_read_parent_node_data_block_from_flash(node_address, (parent_node_t*)&temp_tx_message_pt->hid_message.payload_as_uint16[answer_length/sizeof(uint16_t)]);
+                    }
+                    else if (node_length == sizeof(child_node_t))
+                    {
+                        nodemgmt_read_child_node_data_block_from_flash(node_address, (child_node_t*)&temp_tx_message_pt->hid_message.payload_as_uint16[answer_length/sizeof(uint16_t)]);
+                    }
+                    answer_length += node_length;
+                }
+                
+                /* Send answer */
+                comms_hid_msgs_update_message_payload_length_fields(temp_tx_message_pt, answer_length);
+                comms_aux_mcu_send_message(temp_tx_message_pt);
+                return;
+            }
+            else
+            {
+                /* Set nack, leave same command id */
+                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
+                return;
+            }
+        }
+
         case HID_CMD_WRITE_NODE:
         {
             node_type_te temp_node_type_te;
@@ -1039,7 +1207,8 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
                     && (nodemgmt_check_user_permission(rcv_msg->payload_as_uint16[0], &temp_node_type_te) == RETURN_OK) \
                     && (nodemgmt_check_user_permission(nodemgmt_get_incremented_address(rcv_msg->payload_as_uint16[0]), &temp_node_type_te) == RETURN_OK))
             {
-                /* big node */
+                /* big node, database externally changed */
+                nodemgmt_invalidate_service_index();
                 nodemgmt_write_child_node_block_to_flash(rcv_msg->payload_as_uint16[0], (child_node_t*)&(rcv_msg->payload_as_uint16[1]), FALSE);
 
                 /* Set success byte */
@@ -1049,7 +1218,8 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             else if ((rcv_msg->payload_length == sizeof(uint16_t) + sizeof(parent_node_t)) \
                     && (nodemgmt_check_user_permission(rcv_msg->payload_as_uint16[0], &temp_node_type_te) == RETURN_OK))
             {
-                /* small node */
+                /* small node, database externally changed */
+                nodemgmt_invalidate_service_index();
                 nodemgmt_write_parent_node_data_block_to_flash(rcv_msg->payload_as_uint16[0], (parent_node_t*)&(rcv_msg->payload_as_uint16[1]));
 
                 /* Set success byte */
@@ -1064,6 +1234,224 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
             }
         }
 
+        case HID_CMD_WRITE_NODES:
+        {
+            nodemgmt_node_write_request_t write_requests[NODEMGMT_MAX_NB_NODE_WRITES];
+            BOOL write_request_allowed[NODEMGMT_MAX_NB_NODE_WRITES];
+            uint16_t nb_write_requests = 0;
+            uint16_t nb_allowed_write_requests = 0;
+            uint16_t payload_offset = 0;
+            
+            /* Parse the [address][node size][node] sequence */
+            while ((payload_offset < rcv_msg->payload_length) && (nb_write_requests < NODEMGMT_MAX_NB_NODE_WRITES))
+            {
+                node_type_te temp_node_type_te;
+                
+                /* Check for header and node size */
+                if (payload_offset + 2*sizeof(uint16_t) > rcv_msg->payload_length)
+                {
+                    break;
+                }
+                uint16_t node_address = rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t)];
+                uint16_t node_size = rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t) + 1];
+                if (((node_size != sizeof(parent_node_t)) && (node_size != sizeof(child_node_t))) || (payload_offset + 2*sizeof(uint16_t) + node_size > rcv_msg->payload_length))
+                {
+                    break;
+                }
+                
+                /* Same permission checks as single node write */
+                write_requests[nb_write_requests].address = node_address;
+                write_requests[nb_write_requests].node_size = node_size;
+                write_requests[nb_write_requests].node_pt = (void*)&(rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t) + 2]);
+                if (node_size == sizeof(child_node_t))
+                {
+                    write_request_allowed[nb_write_requests] = (nodemgmt_check_user_permission(node_address, &temp_node_type_te) == RETURN_OK) && (nodemgmt_check_user_permission(nodemgmt_get_incremented_address(node_address), &temp_node_type_te) == RETURN_OK);
+                }
+                else
+                {
+                    write_request_allowed[nb_write_requests] = (nodemgmt_check_user_permission(node_address, &temp_node_type_te) == RETURN_OK);
+                }
+                
+                payload_offset += 2*sizeof(uint16_t) + node_size;
+                nb_write_requests++;
+            }
+            
+            /* Malformed message: nack without writing anything */
+            if ((nb_write_requests == 0) || (payload_offset != rcv_msg->payload_length))
+            {
+                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
+                return;
+            }
+            
+            /* Database externally changed */
+            nodemgmt_invalidate_service_index();
+            
+            /* Write the allowed nodes, grouping the ones sharing a flash page */
+            for (uint16_t i = 0; i < nb_write_requests; i++)
+            {
+                if (write_request_allowed[i] != FALSE)
+                {
+                    write_requests[nb_allowed_write_requests++] = write_requests[i];
+                }
+            }
+            nodemgmt_write_node_blocks_to_flash(write_requests, nb_allowed_write_requests);
+            
+            /* Answer: one status byte per node, in request order */
+            aux_mcu_message_t* temp_tx_message_pt = comms_hid_msgs_get_empty_hid_packet(is_message_from_usb, rcv_message_type, nb_write_requests);
+            for (uint16_t i = 0; i < nb_write_requests; i++)
+            {
+                if (write_request_allowed[i] != FALSE)
+                {
+                    temp_tx_message_pt->hid_message.payload[i] = HID_1BYTE_ACK;
+                }
+                else
+                {
+                    temp_tx_message_pt->hid_message.payload[i] = HID_1BYTE_NACK;
+                }
+            }
+            comms_aux_mcu_send_message(temp_tx_message_pt);
+            return;
+        }
+
+        case HID_CMD_GET_CHANGED_NODES:
+        {
+            /* Check payload length: cred change number, data change number, number of addresses to skip */
+            /* The change journal is shared by all users, in the bonding information pages of sector 0 left unused (no space is left in the user profiles) */
+            /* Each user has its own "entries lost up to" change numbers: HID_CHANGED_NODES_JOURNAL_LOST is answered if this user's changes weren't tracked or were evicted since the provided change numbers */
+            if (rcv_msg->payload_length == 2*sizeof(uint32_t) + sizeof(uint16_t))
+            {
+                aux_mcu_message_t* temp_tx_message_pt = comms_hid_msgs_get_empty_hid_packet(is_message_from_usb, rcv_message_type, 0);
+                uint16_t max_nb_addresses = (max_payload_size - 2*sizeof(uint16_t)) / sizeof(uint16_t);
+                uint16_t nb_addresses = 0;
+                BOOL more_addresses;
+                
+                /* Answer: journal status, more addresses flag, then the addresses */
+                if (nodemgmt_get_changed_node_addresses(rcv_msg->payload_as_uint32[0], rcv_msg->payload_as_uint32[1], rcv_msg->payload_as_uint16[4], &temp_tx_message_pt->hid_message.payload_as_uint16[2], max_nb_addresses, &nb_addresses, &more_addresses) == RETURN_OK)
+                {
+                    temp_tx_message_pt->hid_message.payload_as_uint16[0] = HID_CHANGED_NODES_JOURNAL_OK;
+                    temp_tx_message_pt->hid_message.payload_as_uint16[1] = (uint16_t)more_addresses;
+                }
+                else
+                {
+                    /* Journal lost: full resync required */
+                    temp_tx_message_pt->hid_message.payload_as_uint16[0] = HID_CHANGED_NODES_JOURNAL_LOST;
+                    temp_tx_message_pt->hid_message.payload_as_uint16[1] = FALSE;
+                    nb_addresses = 0;
+                }
+                
+                /* Send answer */
+                comms_hid_msgs_update_message_payload_length_fields(temp_tx_message_pt, (2 + nb_addresses)*sizeof(uint16_t));
+                comms_aux_mcu_send_message(temp_tx_message_pt);
+                return;
+            }
+            else
+            {
+                /* Set failure byte */
+                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
+                return;
+            }
+        }
+
+        case HID_CMD_GET_DB_TREE_HASHES:
+        {
+            /* Check payload length: first tree node index, number of tree nodes */
+            if (rcv_msg->payload_length == 2*sizeof(uint16_t))
+            {
+                aux_mcu_message_t* temp_tx_message_pt = comms_hid_msgs_get_empty_hid_packet(is_message_from_usb, rcv_message_type, 0);
+                uint16_t nb_tree_nodes = rcv_msg->payload_as_uint16[1];
+                page_hash_ret_te hashes_return = RETURN_PHASH_INVALID_NODES;
+                
+                if (nb_tree_nodes <= (max_payload_size - 2*sizeof(uint16_t)) / sizeof(uint32_t))
+                {
+                    hashes_return = nodemgmt_get_page_hash_tree_hashes(rcv_msg->payload_as_uint16[0], nb_tree_nodes, &temp_tx_message_pt->hid_message.payload_as_uint32[1]);
+                }
+                
+                /* Leaves computation is capped per request: ask the computer to send the same request again */
+                if (hashes_return == RETURN_PHASH_NOT_READY)
+                {
+                    temp_tx_message_pt->hid_message.message_type = HID_CMD_ID_RETRY;
+                    comms_hid_msgs_update_message_payload_length_fields(temp_tx_message_pt, 0);
+                    comms_aux_mcu_send_message(temp_tx_message_pt);
+                    return;
+                }
+                
+                /* Answer: number of leaves, pages per leaf, then the hashes */
+                if (hashes_return == RETURN_PHASH_OK)
+                {
+                    temp_tx_message_pt->hid_message.payload_as_uint16[0] = NODEMGMT_PAGE_HASH_NB_LEAVES;
+                    temp_tx_message_pt->hid_message.payload_as_uint16[1] = NODEMGMT_PAGE_HASH_PAGES_PER_LEAF;
+                    comms_hid_msgs_update_message_payload_length_fields(temp_tx_message_pt, 2*sizeof(uint16_t) + nb_tree_nodes*sizeof(uint32_t));
+                    comms_aux_mcu_send_message(temp_tx_message_pt);
+                    return;
+                }
+                else
+                {
+                    /* Invalid tree nodes: send nack using the packet we already have */
+                    comms_hid_msgs_update_message_payload_length_fields(temp_tx_message_pt, 1);
+                    temp_tx_message_pt->hid_message.payload[0] = HID_1BYTE_NACK;
+                    comms_aux_mcu_send_message(temp_tx_message_pt);
+                    return;
+                }
+            }
+            else
+            {
+                /* Set failure byte */
+                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
+                return;
+            }
+        }
+
+        case HID_CMD_IMPORT_CREDS:
+        {
+            /* Answer: one status byte per record, worst case is records only containing a one character service */
+            uint8_t record_statuses[MEMBER_ARRAY_SIZE(hid_message_t,payload)/(sizeof(uint16_t) + sizeof(hid_message_store_cred_t) + 2*sizeof(cust_char_t))];
+            uint16_t service_hint_address = NODE_ADDR_NULL;
+            uint16_t payload_offset = 0;
+            uint16_t nb_records = 0;
+            
+            /* Check the [record size][store credential request] sequence framing */
+            while ((payload_offset + sizeof(uint16_t) <= rcv_msg->payload_length) && (nb_records < ARRAY_SIZE(record_statuses)))
+            {
+                uint16_t record_size = rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t)];
+                if ((record_size < sizeof(hid_message_store_cred_t)) || ((record_size % sizeof(uint16_t)) != 0) || (payload_offset + sizeof(uint16_t) + record_size > rcv_msg->payload_length))
+                {
+                    break;
+                }
+                payload_offset += sizeof(uint16_t) + record_size;
+                nb_records++;
+            }
+            
+            /* Malformed message or import not possible (host should then use store credential) */
+            if ((nb_records == 0) || (payload_offset != rcv_msg->payload_length) || (logic_user_prepare_credentials_import(nb_records) != RETURN_OK))
+            {
+                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
+                return;
+            }
+            
+            /* Records are sorted by service: each new service insertion point search starts from the previous service */
+            payload_offset = 0;
+            for (uint16_t i = 0; i < nb_records; i++)
+            {
+                uint16_t record_size = rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t)];
+                hid_message_store_cred_t* store_cred_pt = (hid_message_store_cred_t*)&(rcv_msg->payload_as_uint16[payload_offset/sizeof(uint16_t) + 1]);
+                cust_char_t* store_cred_field_pts[5];
+                
+                record_statuses[i] = HID_1BYTE_NACK;
+                if ((comms_hid_msgs_check_store_cred_request(store_cred_pt, (record_size - sizeof(hid_message_store_cred_t))/sizeof(cust_char_t), store_cred_field_pts) == RETURN_OK) && \
+                    (logic_user_import_credential(store_cred_field_pts[0], store_cred_field_pts[1], store_cred_field_pts[2], store_cred_field_pts[3], store_cred_field_pts[4], &service_hint_address) == RETURN_OK))
+                {
+                    record_statuses[i] = HID_1BYTE_ACK;
+                }
+                payload_offset += sizeof(uint16_t) + record_size;
+            }
+            
+            /* Send answer */
+            aux_mcu_message_t* temp_tx_message_pt = comms_hid_msgs_get_empty_hid_packet(is_message_from_usb, rcv_message_type, nb_records);
+            memcpy(temp_tx_message_pt->hid_message.payload, record_statuses, nb_records);
+            comms_aux_mcu_send_message(temp_tx_message_pt);
+            return;
+        }
+
         case HID_CMD_GET_USER_CHANGE_NB :
         {
             /* Smartcard unlocked? */
@@ -1433,103 +1821,18 @@ void comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_leng
         
         case HID_CMD_ID_STORE_CRED:
         {               
-            /********************************/
-            /* Here comes the sanity checks */
-            /********************************/
-            
-            /* Incorrect service name index */
-            if (rcv_msg->store_credential.service_name_index != 0)
-            {
-                comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
-                return;
-            }
+            cust_char_t* store_cred_field_pts[5];
+            uint16_t max_cust_char_length = (max_payload_size - sizeof(hid_message_store_cred_t))/sizeof(cust_char_t);
             
-            /* Empty service name */
-            if (rcv_msg->store_credential.concatenated_strings[0] == 0)
+            /* Here comes the sanity checks */
+            if (comms_hid_msgs_check_store_cred_request(&rcv_msg->store_credential, max_cust_char_length, store_cred_field_pts) != RETURN_OK)
             {
                 comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
                 return;
             }
             
-            /* Sequential order check */
-            uint16_t temp_length = 0;
-            uint16_t prev_length = 0;
-            uint16_t prev_check_index = 0;
-            uint16_t current_check_index = 0;
-            uint16_t check_indexes[5] = {   rcv_msg->store_credential.service_name_index, \
-                                            rcv_msg->store_credential.login_name_index, \
-                                            rcv_msg->store_credential.description_index, \
-                                            rcv_msg->store_credential.third_field_index, \
-                                            rcv_msg->store_credential.password_index};
-            uint16_t max_cust_char_length = (max_payload_size \
-                                            - sizeof(rcv_msg->store_credential.service_name_index) \
-                                            - sizeof(rcv_msg->store_credential.login_name_index) \
-                                            - sizeof(rcv_msg->store_credential.description_index) \
-                                            - sizeof(rcv_msg->store_credential.third_field_index) \
-                                            - sizeof(rcv_msg->store_credential.password_index))/sizeof(cust_char_t);
-            
-            /* Check all fields */                              
-            for (uint16_t i = 0; i < ARRAY_SIZE(check_indexes); i++)
-            {
-                current_check_index = check_indexes[i];
-                
-                /* If index indicates present field */
-                if (current_check_index != UINT16_MAX)
-                {
-                    /* If index is correct */
-                    if (current_check_index != prev_check_index + prev_length)
-                    {
-                        comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
-                        return;
-                    }
-                    
-                    /* Get string length */
-                    temp_length = utils_strnlen(&(rcv_msg->store_credential.concatenated_strings[current_check_index]), max_cust_char_length);
-                    
-                    /* Too long length */
-                    if (temp_length == max_cust_char_length)
-                    {
-                        comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, FALSE);
-                        return;
-                    }
-                    
-                    /* Store previous index & length */
-                    prev_length = temp_length + 1;
-                    prev_check_index = current_check_index;
-                    
-                    /* Reduce max length */
-                    max_cust_char_length -= (temp_length + 1);
-                }              
-            }    
-            
-            /* Dirty hack for fields not set */
-            uint16_t empty_string_index = utils_strlen(rcv_msg->store_credential.concatenated_strings);
-            if (rcv_msg->store_credential.login_name_index == UINT16_MAX)
-            {
-                rcv_msg->store_credential.login_name_index = empty_string_index;
-            }
-            
-            /* In case we only want to update certain fields */
-            cust_char_t* description_field_pt = (cust_char_t*)0;
-            cust_char_t* third_field_pt = (cust_char_t*)0;
-            cust_char_t* password_field_pt = (cust_char_t*)0;
-            if (rcv_msg->store_credential.description_index != UINT16_MAX)
-            {
-                description_field_pt = &(rcv_msg->store_credential.concatenated_strings[rcv_msg->store_credential.description_index]);
-            }
-            if (rcv_msg->store_credential.third_field_index != UINT16_MAX)
-            {
-                third_field_pt = &(rcv_msg->store_credential.concatenated_strings[rcv_msg->store_credential.third_field_index]);
-            }
-            if (rcv_msg->store_credential.password_index != UINT16_MAX)
-            {
-                password_field_pt = &(rcv_msg->store_credential.concatenated_strings[rcv_msg->store_credential.password_index]);
-            }
-            
             /* Proceed to other logic */
-            if (logic_user_store_credential(    &(rcv_msg->store_credential.concatenated_strings[rcv_msg->store_credential.service_name_index]),\
-                                                &(rcv_msg->store_credential.concatenated_strings[rcv_msg->store_credential.login_name_index]),\
-                                                description_field_pt, third_field_pt, password_field_pt) == RETURN_OK)
+            if (logic_user_store_credential(store_cred_field_pts[0], store_cred_field_pts[1], store_cred_field_pts[2], store_cred_field_pts[3], store_cred_field_pts[4]) == RETURN_OK)
             {
                 comms_hid_msgs_send_ack_nack_message(is_message_from_usb, rcv_message_type, TRUE);
                 return;        
@@ -3,12 +3,49 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+/* Bundle image, mapped read-only (or loaded in memory when mmap isn't available) */
+static const uint8_t* bundle_data = NULL;
+static uint32_t bundle_size = 0;
+
+/* Continuous read cursor */
+static uint32_t bundle_cursor = 0;
+
+static BOOL emu_dataflash_map_bundle(int fd)
+{
+    struct stat bundle_stat;
+
+    if((fstat(fd, &bundle_stat) != 0) || (bundle_stat.st_size <= 0))
+        return FALSE;
 
-static int bundle_fd = -1;
+#ifndef WIN32
+    void* map = mmap(NULL, bundle_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED)
+        return FALSE;
+    bundle_data = map;
+#else
+    uint8_t* buffer = malloc(bundle_stat.st_size);
+    if((buffer == NULL) || (read(fd, buffer, bundle_stat.st_size) != bundle_stat.st_size)) {
+        free(buffer);
+        return FALSE;
+    }
+    bundle_data = buffer;
+#endif
+
+    bundle_size = (uint32_t)bundle_stat.st_size;
+    return TRUE;
+}
 
 void emu_dataflash_init(const char *path)
 {
     int i;
+    int bundle_fd;
     const char *bundle_paths[] = {
     #ifndef WIN32    
         XSTR(DESTDIR) XSTR(PREFIX) "/share/misc/miniblebundle.img",
@@ -31,8 +68,15 @@ void emu_dataflash_init(const char *path)
 #else
         bundle_fd = open(bundle_paths[i], O_RDONLY);
 #endif
-        if(bundle_fd >= 0)
-            return;
+        if(bundle_fd >= 0) {
+            /* The mapping stays valid once the file is closed */
+            BOOL mapped = emu_dataflash_map_bundle(bundle_fd);
+            close(bundle_fd);
+            if(mapped)
+                return;
+
+            fprintf(stderr, "Failed to map bundle file %s\n", bundle_paths[i]);
+        }
     }
 
     fprintf(stderr, "Failed to open bundle file, tried:\n");
@@ -41,21 +85,45 @@ void emu_dataflash_init(const char *path)
 
 }
 
+const uint8_t* emu_dataflash_get_pointer(uint32_t address, uint32_t length)
+{
+    if((bundle_data == NULL) || (address > bundle_size) || (length > bundle_size - address))
+        return NULL;
+
+    return &bundle_data[address];
+}
+
+static void emu_dataflash_copy(uint32_t address, uint8_t* data, uint32_t length)
+{
+    const uint8_t* src = emu_dataflash_get_pointer(address, length);
+
+    if(src != NULL) {
+        memcpy(data, src, length);
+
+    } else {
+        /* Outside of the bundle: erased flash */
+        memset(data, 0xFF, length);
+        if((bundle_data != NULL) && (address < bundle_size))
+            memcpy(data, &bundle_data[address], bundle_size - address);
+    }
+}
+
 void dataflash_write_array_to_memory(spi_flash_descriptor_t* descriptor_pt, uint32_t address, uint8_t* data, uint32_t length){}
 void dataflash_read_data_array(spi_flash_descriptor_t* descriptor_pt, uint32_t address, uint8_t* data, uint32_t length) 
 {
-    lseek(bundle_fd, address, SEEK_SET);
-    read(bundle_fd, data, length);
+    emu_dataflash_copy(address, data, length);
+    bundle_cursor = address + length;
 }
 
 void dataflash_read_bytes_from_opened_transfer(spi_flash_descriptor_t* descriptor_pt, uint8_t* data, uint32_t length) {
-    read(bundle_fd, data, length);
+    emu_dataflash_copy(bundle_cursor, data, length);
+    bundle_cursor += length;
 }
 
 void dataflash_send_command(spi_flash_descriptor_t* descriptor_pt, uint8_t* data, uint32_t length){}
 void dataflash_send_single_byte_command(spi_flash_descriptor_t* descriptor_pt, uint8_t command){}
 void dataflash_read_data_array_start(spi_flash_descriptor_t* descriptor_pt, uint32_t address) {
-    lseek(bundle_fd, address, SEEK_SET);
+    bundle_cursor = address;
 }
 
 void dataflash_erase_64kb_block(spi_flash_descriptor_t* descriptor_pt, uint32_t address){}
@@ -30,13 +30,31 @@ void dbflash_page_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumb
     free(tmp);
 }
 
+/* Emulated flash internal buffer */
+static uint8_t dbflash_internal_buffer[BYTES_PER_PAGE];
+
+void dbflash_load_page_to_internal_buffer(spi_flash_descriptor_t* descriptor_pt, uint16_t page_number)
+{
+    dbflash_read_data_from_flash(descriptor_pt, page_number, 0, BYTES_PER_PAGE, dbflash_internal_buffer);
+}
+
+void dbflash_write_data_to_internal_buffer(spi_flash_descriptor_t* descriptor_pt, uint16_t offset, uint16_t dataSize, void *data)
+{
+    memcpy(&dbflash_internal_buffer[offset], data, dataSize);
+}
+
+void dbflash_flash_write_buffer_to_page(spi_flash_descriptor_t* descriptor_pt, uint16_t page)
+{
+    dbflash_write_data_to_flash(descriptor_pt, page, 0, BYTES_PER_PAGE, dbflash_internal_buffer);
+}
+
 static BOOL initialized = FALSE;
 
 RET_TYPE dbflash_check_presence(spi_flash_descriptor_t* descriptor_pt)
 {   
     if(!initialized) {
         initialized = TRUE;
-        emu_dbflash_open();
+        emu_dbflash_open(PAGE_COUNT * BYTES_PER_PAGE);
     }
 
     return RETURN_OK;
@@ -1,7 +1,11 @@
 #include "dma.h"
 #include "emu_aux_mcu.h"
+#include "emu_oled.h"
 
-void dma_oled_init_transfer(Sercom* sercom, void* datap, uint16_t size, uint16_t dma_trigger){}
+void dma_oled_init_transfer(Sercom* sercom, void* datap, uint16_t size, uint16_t dma_trigger)
+{
+    emu_oled_data(datap, size);
+}
 void dma_acc_init_transfer(Sercom* sercom, void* datap, uint16_t size, uint8_t* read_cmd){}
 uint32_t dma_compute_crc32_from_spi(Sercom* sercom, uint32_t size){return 0;}
 
@@ -1,6 +1,7 @@
 #include "emu_aux_mcu.h"
 #include "comms_aux_mcu.h"
 #include "emulator.h"
+#include "emu_replay.h"
 
 #include <assert.h>
 #include <string.h>
@@ -272,6 +273,9 @@ static void send_hid_message(aux_mcu_message_t *msg)
     uint8_t *payload = msg->payload;
     int payload_length = msg->payload_length1;
 
+    /* answer to the last message from moolticute, if it is still pending */
+    emu_hid_cmd_end();
+
     int n_hid_packets = (payload_length+61) / 62;
     int p;
 
@@ -384,31 +388,41 @@ static BOOL process_hid_packet(uint8_t *packet, int payloadLength)
 /*! \fn     rcv_hid_messages(void)
 *   \brief  Receive simulated "hid" messages from moolticute & reassemble messages
 *   \note   The packets are concatenated into a stream, but we can split them up based on the payload length byte.
+*   \note   All the packets already received are processed, so that the firmware only sees completed messages
 */
 static int emu_rcv_aux_hid(aux_mcu_message_t *msg)
 {
-    int nr = emu_rcv_hid((char*)incomingHidPacket + incomingHidFill, sizeof(incomingHidPacket) - incomingHidFill);
     BOOL hid_response_valid = FALSE;
 
-    if(nr < 0) {
-        /* Moolticute not connected, reset buffers */
-        reset_hid_processing();
-        return 0;
-    }
+    while(hid_response_valid == FALSE) {
+        int hidPayloadLength = -1;
 
-    incomingHidFill += nr;
-
-    if(incomingHidFill >= 2) {
-        int hidPayloadLength = incomingHidPacket[0] & 63;
-        if(incomingHidPacket[0] == 0xff && incomingHidPacket[1] == 0xff)
-            hidPayloadLength = 0; /* special case */
+        if(incomingHidFill >= 2) {
+            hidPayloadLength = incomingHidPacket[0] & 63;
+            if(incomingHidPacket[0] == 0xff && incomingHidPacket[1] == 0xff)
+                hidPayloadLength = 0; /* special case */
+        }
 
         if(hidPayloadLength > 62) {
             fprintf(stderr, "Invalid HID packet received, byte0 = %x\n", incomingHidPacket[0]);
             reset_hid_processing();
             return 0;
 
-        } else if(incomingHidFill >= hidPayloadLength+2) {
+        } else if(hidPayloadLength < 0 || incomingHidFill < hidPayloadLength+2) {
+            /* Current packet incomplete, fetch more bytes */
+            int nr = emu_rcv_hid((char*)incomingHidPacket + incomingHidFill, sizeof(incomingHidPacket) - incomingHidFill);
+
+            if(nr < 0) {
+                /* Moolticute not connected, reset buffers */
+                reset_hid_processing();
+                return 0;
+            }
+            if(nr == 0)
+                break;
+
+            incomingHidFill += nr;
+
+        } else {
             hid_response_valid = process_hid_packet(incomingHidPacket, hidPayloadLength);
         
             if(hid_response_valid && (incomingHidPacket[0] & 0x40)) {
@@ -423,6 +437,7 @@ static int emu_rcv_aux_hid(aux_mcu_message_t *msg)
     }
 
     if(hid_response_valid) {
+        emu_hid_cmd_start(hid_response.hid_message.message_type);
         memcpy(msg, &hid_response, sizeof(hid_response));
         hid_response_valid = FALSE;
         return sizeof(hid_response);
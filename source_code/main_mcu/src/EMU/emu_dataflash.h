@@ -1,11 +1,13 @@
 #ifndef EMU_DATAFLASH_H
 #define EMU_DATAFLASH_H
+#include <inttypes.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void emu_dataflash_init(const char *path);
+const uint8_t* emu_dataflash_get_pointer(uint32_t address, uint32_t length);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,182 @@
+#include "emu_headless.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSocketNotifier>
+#include <QFile>
+#include <QTimer>
+
+#include "emulator.h"
+#include "emu_oled.h"
+#include "emu_smartcard.h"
+#include "emu_storage.h"
+#include "emu_snapshot.h"
+
+#define FB_SIZE (256 * 64)
+
+/* Commands, one per line, answered by "OK" or "ERR <reason>":
+ *  wheel <n>                       scroll the wheel by n steps (negative: up)
+ *  press [long] / release          press or release the wheel
+ *  click [long]                    press the wheel, release it 50ms later
+ *  card insert|new <file>          insert an existing / a new blank smartcard
+ *  card remove                     remove the smartcard
+ *  battery <0-100>                 set the battery level
+ *  usb on|off                      plug or unplug usb power
+ *  lefthanded on|off               set the accelerometer orientation
+ *  failures <flags>                set the failure flags, see EMU_FAIL_xxx
+ *  oled dump [file]                raw 256x64 8-bit grayscale frame, written to file or
+ *                                  sent after an "OK <size> <display on>" line
+ *  snapshot <dir>                  save the device state, restore it with --restore <dir>
+ *  sync                            write the emulated flash changes to disk
+ *  quit                            exit the emulator
+ */
+static QByteArray emu_headless_handle_command(const QByteArray & line)
+{
+    QList<QByteArray> args = line.simplified().split(' ');
+    const QByteArray & cmd = args[0];
+    bool on = (args.size() > 1) && (args[1] == "on");
+    bool is_long = (args.size() > 1) && (args[1] == "long");
+    bool ok = true;
+
+    if(cmd.isEmpty()) {
+        return QByteArray();
+
+    } else if(cmd == "wheel" && args.size() == 2) {
+        int increment = args[1].toInt(&ok);
+        if(!ok)
+            return "ERR invalid increment\n";
+        emu_wheel_scroll(increment);
+
+    } else if(cmd == "press") {
+        emu_wheel_press(true, is_long);
+
+    } else if(cmd == "release") {
+        emu_wheel_press(false, false);
+
+    } else if(cmd == "click") {
+        emu_wheel_press(true, is_long);
+        QTimer::singleShot(50, [] () { emu_wheel_press(false, false); });
+
+    } else if(cmd == "card" && args.size() == 3 && args[1] == "insert") {
+        if(!emu_insert_smartcard(QString::fromLocal8Bit(args[2])))
+            return "ERR can't open smartcard file\n";
+
+    } else if(cmd == "card" && args.size() == 3 && args[1] == "new") {
+        if(!emu_insert_new_smartcard(QString::fromLocal8Bit(args[2])))
+            return "ERR can't create smartcard file\n";
+
+    } else if(cmd == "card" && args.size() == 2 && args[1] == "remove") {
+        emu_remove_smartcard();
+
+    } else if(cmd == "battery" && args.size() == 2) {
+        int level = args[1].toInt(&ok);
+        if(!ok)
+            return "ERR invalid level\n";
+        emu_set_battery_level(level);
+
+    } else if(cmd == "usb" && args.size() == 2) {
+        emu_set_usb_powered(on);
+
+    } else if(cmd == "lefthanded" && args.size() == 2) {
+        emu_set_lefthanded(on);
+
+    } else if(cmd == "failures" && args.size() == 2) {
+        int flags = args[1].toInt(&ok, 0);
+        if(!ok)
+            return "ERR invalid flags\n";
+        emu_set_failure_flags(flags);
+
+    } else if(cmd == "oled" && args.size() >= 2 && args[1] == "dump") {
+        QByteArray fb(FB_SIZE, 0);
+        bool display_on = emu_oled_get_framebuffer((uint8_t*)fb.data());
+
+        if(args.size() == 3) {
+            QFile dump(QString::fromLocal8Bit(args[2]));
+            if(!dump.open(QIODevice::WriteOnly) || dump.write(fb) != fb.size())
+                return "ERR can't write dump file\n";
+
+        } else {
+            return QByteArray("OK ") + QByteArray::number(FB_SIZE) + " " + (display_on ? "1" : "0") + "\n" + fb;
+        }
+
+    } else if(cmd == "snapshot" && args.size() == 2) {
+        if(!emu_snapshot_request(QString::fromLocal8Bit(args[1])))
+            return "ERR snapshot failed\n";
+
+    } else if(cmd == "sync") {
+        emu_storage_sync(TRUE);
+
+    } else if(cmd == "quit") {
+        QCoreApplication::quit();
+
+    } else {
+        return "ERR unknown command\n";
+    }
+
+    return "OK\n";
+}
+
+static void emu_headless_init_stdin(void)
+{
+    static QByteArray stdin_buffer;
+    auto notifier = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, QCoreApplication::instance());
+
+    QObject::connect(notifier, &QSocketNotifier::activated, [notifier] () {
+        char buf[256];
+        ssize_t nb = read(STDIN_FILENO, buf, sizeof(buf));
+
+        // stdin closed: keep running, the socket may still be used
+        if(nb <= 0) {
+            notifier->setEnabled(false);
+            return;
+        }
+
+        stdin_buffer.append(buf, nb);
+        for(int eol = stdin_buffer.indexOf('\n'); eol >= 0; eol = stdin_buffer.indexOf('\n')) {
+            QByteArray answer = emu_headless_handle_command(stdin_buffer.left(eol));
+            stdin_buffer.remove(0, eol + 1);
+            fwrite(answer.constData(), 1, answer.size(), stdout);
+            fflush(stdout);
+        }
+    });
+}
+
+static void emu_headless_init_socket(const QString & control_socket_name)
+{
+    auto server = new QLocalServer(QCoreApplication::instance());
+
+    QLocalServer::removeServer(control_socket_name);
+    if(!server->listen(control_socket_name)) {
+        fprintf(stderr, "Failed to listen on control socket %s\n", qPrintable(control_socket_name));
+        return;
+    }
+
+    QObject::connect(server, &QLocalServer::newConnection, [server] () {
+        while(QLocalSocket *client = server->nextPendingConnection()) {
+            QObject::connect(client, &QLocalSocket::disconnected, client, &QLocalSocket::deleteLater);
+            QObject::connect(client, &QLocalSocket::readyRead, [client] () {
+                while(client->canReadLine())
+                    client->write(emu_headless_handle_command(client->readLine()));
+            });
+        }
+    });
+}
+
+void emu_headless_init(const QString & control_socket_name)
+{
+    emu_headless_init_stdin();
+
+    if(!control_socket_name.isEmpty())
+        emu_headless_init_socket(control_socket_name);
+
+    // battery charging, done by the battery slider in the UI build
+    auto charger = new QTimer(QCoreApplication::instance());
+    QObject::connect(charger, &QTimer::timeout, [] () {
+        if(emu_is_battery_charging())
+            emu_set_battery_level(emu_get_battery_level() + 5);
+    });
+    charger->start(500);
+}
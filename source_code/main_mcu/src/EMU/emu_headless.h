@@ -0,0 +1,10 @@
+#ifndef EMU_HEADLESS_H
+#define EMU_HEADLESS_H
+
+#include <QString>
+
+// Line based control channel replacing the UI: commands are read from stdin and
+// from the local socket named control_socket_name (if not empty), see emu_headless.cpp
+void emu_headless_init(const QString & control_socket_name);
+
+#endif
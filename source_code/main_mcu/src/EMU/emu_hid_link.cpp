@@ -0,0 +1,188 @@
+#include "emu_hid_link.h"
+
+#include <string.h>
+#include <atomic>
+#include <QThread>
+#include <QTimer>
+#include <QSemaphore>
+#include <QLocalSocket>
+
+#include "emulator.h"
+#include "qt_metacall_helper.h"
+
+// Single producer / single consumer byte ring. Indexes are free running, SIZE must be a power of 2
+template <uint32_t SIZE>
+class ByteRing {
+private:
+    char buf[SIZE];
+    std::atomic<uint32_t> head{0};  // written by the producer
+    std::atomic<uint32_t> tail{0};  // written by the consumer
+
+public:
+    int write(const char *data, int size) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t nb = qMin<uint32_t>(size, SIZE - (h - tail.load(std::memory_order_acquire)));
+        uint32_t first = qMin(nb, SIZE - (h & (SIZE-1)));
+
+        memcpy(&buf[h & (SIZE-1)], data, first);
+        memcpy(buf, data + first, nb - first);
+        head.store(h + nb, std::memory_order_release);
+        return nb;
+    }
+
+    int read(char *data, int size) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t nb = qMin<uint32_t>(size, head.load(std::memory_order_acquire) - t);
+        uint32_t first = qMin(nb, SIZE - (t & (SIZE-1)));
+
+        memcpy(data, &buf[t & (SIZE-1)], first);
+        memcpy(data + first, buf, nb - first);
+        tail.store(t + nb, std::memory_order_release);
+        return nb;
+    }
+
+    // consumer side only
+    void discard(void) {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    int free_space(void) {
+        return SIZE - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+};
+
+#define RING_SIZE (64*1024)
+
+static ByteRing<RING_SIZE> tx_ring;
+static ByteRing<RING_SIZE> rx_ring;
+
+static std::atomic<bool> connected(false);
+static std::atomic<bool> tx_flush_posted(false);
+static std::atomic<bool> rx_stalled(false);
+
+class HidLinkThread: public QThread {
+public:
+    QString socket_name;
+    QObject *io = nullptr;
+    QLocalSocket *socket = nullptr;
+    QSemaphore started;
+
+    void run() {
+        QObject io_object;
+        QLocalSocket local_socket;
+        QTimer reconnect_timer;
+
+        io = &io_object;
+        socket = &local_socket;
+
+        reconnect_timer.setSingleShot(true);
+        reconnect_timer.setInterval(100);
+        QObject::connect(&reconnect_timer, &QTimer::timeout, [this] () {
+            socket->connectToServer(socket_name);
+        });
+
+        QObject::connect(socket, &QLocalSocket::connected, [] () {
+            connected = true;
+        });
+        QObject::connect(socket, &QLocalSocket::disconnected, [&reconnect_timer] () {
+            connected = false;
+            tx_ring.discard();
+            reconnect_timer.start();
+        });
+        QObject::connect(socket, static_cast<void (QLocalSocket::*)(QLocalSocket::LocalSocketError)>(&QLocalSocket::error), [this, &reconnect_timer] () {
+            // no server yet: retry later
+            if(socket->state() == QLocalSocket::UnconnectedState)
+                reconnect_timer.start();
+        });
+        QObject::connect(socket, &QLocalSocket::readyRead, [this] () {
+            receive();
+        });
+
+        socket->connectToServer(socket_name);
+        started.release();
+        exec();
+
+        connected = false;
+        socket->abort();
+        socket = nullptr;
+        io = nullptr;
+    }
+
+    // move as much incoming data as the rx ring can take, the rest stays in the socket
+    void receive() {
+        char buf[4096];
+        int nb;
+
+        while((nb = qMin<qint64>(qMin(rx_ring.free_space(), (int)sizeof(buf)), socket->bytesAvailable())) > 0) {
+            socket->read(buf, nb);
+            rx_ring.write(buf, nb);
+        }
+
+        if(socket->bytesAvailable() > 0)
+            rx_stalled = true;
+
+        emu_idle_wake();
+    }
+
+    // all the packets queued since the last flush go out in a single socket write
+    void flush() {
+        static char buf[RING_SIZE];
+        tx_flush_posted = false;
+
+        int nb = tx_ring.read(buf, sizeof(buf));
+        if(nb > 0 && socket->state() == QLocalSocket::ConnectedState)
+            socket->write(buf, nb);
+    }
+};
+
+static HidLinkThread link_thread;
+
+void emu_hid_link_start(const QString & socket_name)
+{
+    link_thread.socket_name = socket_name;
+    link_thread.start();
+    link_thread.started.acquire();
+}
+
+void emu_hid_link_stop(void)
+{
+    link_thread.quit();
+    link_thread.wait();
+}
+
+bool emu_hid_link_is_connected(void)
+{
+    return connected;
+}
+
+void emu_hid_link_send(const char *data, int size)
+{
+    while(connected && size > 0) {
+        int nb = tx_ring.write(data, size);
+        data += nb;
+        size -= nb;
+
+        if(!tx_flush_posted.exchange(true))
+            postToObject([] () { link_thread.flush(); }, link_thread.io);
+
+        // ring full: let the I/O thread drain it
+        if(size > 0)
+            QThread::yieldCurrentThread();
+    }
+}
+
+int emu_hid_link_receive(char *data, int size)
+{
+    // drop whatever was received from a previous connection
+    if(!connected) {
+        rx_ring.discard();
+        return -1;
+    }
+
+    int nb = rx_ring.read(data, size);
+
+    if(nb > 0 && rx_stalled.exchange(false))
+        postToObject([] () { link_thread.receive(); }, link_thread.io);
+
+    return nb;
+}
@@ -0,0 +1,16 @@
+#ifndef EMU_HID_LINK_H
+#define EMU_HID_LINK_H
+
+#include <QString>
+
+// HID bridge to moolticute: the local socket is served by its own I/O thread and
+// exchanges bytes with the firmware thread through lock-free rings, see emu_hid_link.cpp
+void emu_hid_link_start(const QString & socket_name);
+void emu_hid_link_stop(void);
+
+// firmware thread side
+bool emu_hid_link_is_connected(void);
+void emu_hid_link_send(const char *data, int size);
+int emu_hid_link_receive(char *data, int size);
+
+#endif
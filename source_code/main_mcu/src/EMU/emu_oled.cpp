@@ -1,5 +1,6 @@
 #include "emu_oled.h"
 #include "emulator.h"
+#include "emu_replay.h"
 extern "C" {
 #include <asf.h>
 #include "platform_defines.h"
@@ -9,13 +10,16 @@ extern "C" {
 #include "qt_metacall_helper.h"
 #include <QMutex>
 #include <QSemaphore>
+#include <QThread>
+#include <QTimer>
+#ifndef EMULATOR_HEADLESS
 #include <QApplication>
 #include <QPainter>
+#include <QPaintEvent>
 #include <QWheelEvent>
 #include <QMouseEvent>
 #include <QKeyEvent>
-#include <QThread>
-#include <QTimer>
+#endif
 
 #define FB_WIDTH (256)
 #define FB_HEIGHT (64)
@@ -23,6 +27,10 @@ extern "C" {
 /// grayscale 8-bit
 static uint8_t oled_fb[FB_WIDTH * FB_HEIGHT];
 static int oled_col, oled_row;
+/// rows written since the last flush, one bit per row
+static uint64_t oled_dirty_rows;
+
+static void emu_oled_set_display_on(bool on);
 
 void emu_oled_byte(uint8_t data)
 {
@@ -52,10 +60,10 @@ void emu_oled_byte(uint8_t data)
                 cmdargs = 1;
                 break;
             case SH1122_CMD_SET_DISPLAY_ON:
-                postToObject([]() { oled->set_display_on(true); }, oled);
+                emu_oled_set_display_on(true);
                 break;
             case SH1122_CMD_SET_DISPLAY_OFF:
-                postToObject([]() { oled->set_display_on(false); }, oled);
+                emu_oled_set_display_on(false);
                 break;
             }
 
@@ -73,6 +81,7 @@ void emu_oled_byte(uint8_t data)
         //printf("Oled DATA @%d,%d: %02x\n", oled_col, oled_row, data);
         oled_fb[FB_WIDTH * oled_row + oled_col*2] = data & 0xf0;
         oled_fb[FB_WIDTH * oled_row + oled_col*2 + 1] = (data & 0x0f) << 4;
+        oled_dirty_rows |= 1ULL << oled_row;
         
         if(oled_col == SH1122_OLED_Max_Column) {
             if(oled_row == SH1122_OLED_Max_Row) {
@@ -88,38 +97,111 @@ void emu_oled_byte(uint8_t data)
     }
 }
 
+// expand 4 bytes of 4bpp pixels (high nibble first) to 8 grayscale bytes at once:
+// each byte is spread to its own 16-bit lane of a 64-bit word, then its nibbles are split
+static inline void emu_oled_expand_4_bytes(const uint8_t *src, uint8_t *dst)
+{
+    uint32_t packed;
+    memcpy(&packed, src, sizeof(packed));
+
+    uint64_t lanes = packed;
+    lanes = (lanes | (lanes << 16)) & 0x0000FFFF0000FFFFULL;
+    lanes = (lanes | (lanes << 8)) & 0x00FF00FF00FF00FFULL;
+    uint64_t pixels = (lanes & 0x00F000F000F000F0ULL) | ((lanes & 0x000F000F000F000FULL) << 12);
+
+    memcpy(dst, &pixels, sizeof(pixels));
+}
+
+void emu_oled_data(const uint8_t *data, uint32_t length)
+{
+    // same result as length emu_oled_byte() data bytes, a row at a time
+    while(length > 0) {
+        uint32_t nb_bytes = qMin<uint32_t>(length, SH1122_OLED_Max_Column + 1 - oled_col);
+        uint8_t *dst = &oled_fb[FB_WIDTH * oled_row + oled_col*2];
+        uint32_t i = 0;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        for(; i + 4 <= nb_bytes; i += 4)
+            emu_oled_expand_4_bytes(&data[i], &dst[i*2]);
+#endif
+        for(; i < nb_bytes; i++) {
+            dst[i*2] = data[i] & 0xf0;
+            dst[i*2 + 1] = (data[i] & 0x0f) << 4;
+        }
+
+        oled_dirty_rows |= 1ULL << oled_row;
+        data += nb_bytes;
+        length -= nb_bytes;
+        oled_col += nb_bytes;
+
+        if(oled_col > SH1122_OLED_Max_Column) {
+            oled_row = (oled_row == SH1122_OLED_Max_Row) ? 0 : oled_row + 1;
+            oled_col = 0;
+        }
+    }
+}
+
 static QMutex fb_update;
-static uint8_t framebuffers[2][256*64];
-static int fb_next=0, fb_pending=-1;
+
+/// last flushed frame and display state, for headless dumps and the widget
+static uint8_t fb_last[FB_WIDTH * FB_HEIGHT];
+static bool fb_display_on = true;
+#ifndef EMULATOR_HEADLESS
+/// rows not yet converted by the widget, an update is queued when not 0
+static uint64_t fb_ui_dirty_rows;
+#endif
+
+static void emu_oled_set_display_on(bool on)
+{
+    fb_update.lock();
+    fb_display_on = on;
+    fb_update.unlock();
+
+#ifndef EMULATOR_HEADLESS
+    postToObject([on]() { oled->set_display_on(on); }, oled);
+#endif
+}
+
+bool emu_oled_get_framebuffer(uint8_t *fb)
+{
+    fb_update.lock();
+    memcpy(fb, fb_last, sizeof(fb_last));
+    bool on = fb_display_on;
+    fb_update.unlock();
+    return on;
+}
 
 void emu_oled_flush(void)
 {
     emu_appexit_test();
-    fb_update.lock();
-    if(fb_pending >= 0) {
-        // an update is queued, just replace the contents
-        memcpy(framebuffers[fb_pending], oled_fb, 256*64);
 
-    } else {
-        // request an update
-        int fb_req = fb_next;
-        memcpy(framebuffers[fb_next], oled_fb, 256*64);
-        fb_pending = fb_req;
-        fb_next = (fb_next+1)%2;
-
-        // use a timer to coalesce multiple repaints 
-        QTimer::singleShot(2, oled, [fb_req]() {
+    // called after each SPI transfer: nothing to do for command only transfers
+    if(oled_dirty_rows == 0)
+        return;
+
+    fb_update.lock();
+    for(int y = 0; y < FB_HEIGHT; y++)
+        if(oled_dirty_rows & (1ULL << y))
+            memcpy(&fb_last[FB_WIDTH * y], &oled_fb[FB_WIDTH * y], FB_WIDTH);
+
+#ifndef EMULATOR_HEADLESS
+    if(fb_ui_dirty_rows == 0) {
+        // use a timer to coalesce multiple repaints
+        QTimer::singleShot(2, oled, []() {
             fb_update.lock();
-            if(fb_req == fb_pending)
-                fb_pending = -1;
+            oled->update_display(fb_last, fb_ui_dirty_rows);
+            fb_ui_dirty_rows = 0;
             fb_update.unlock();
-            oled->update_display(framebuffers[fb_req]);
         });
     }
+    fb_ui_dirty_rows |= oled_dirty_rows;
+#endif
 
+    oled_dirty_rows = 0;
     fb_update.unlock();
 }
 
+#ifndef EMULATOR_HEADLESS
 OLEDWidget::OLEDWidget(): display(256, 64, QImage::Format_RGB888) {
     setMinimumSize(display.size());
     setMaximumSize(display.size());
@@ -131,16 +213,26 @@ OLEDWidget::~OLEDWidget() {
     QApplication::removePostedEvents(this);
 }
 
-void OLEDWidget::update_display(const uint8_t *fb) {
-    uint8_t *optr = display.bits();
+void OLEDWidget::update_display(const uint8_t *fb, uint64_t dirty_rows) {
+    int ymin = FB_HEIGHT, ymax = -1;
+
+    for(int y=0;y<FB_HEIGHT;y++) {
+        if(!(dirty_rows & (1ULL << y)))
+            continue;
 
-    for(int y=0;y<64;y++)
-        for(int x=0;x<256;x++) {
-            optr[0] = optr[1] = optr[2] = *fb++;
+        const uint8_t *iptr = &fb[FB_WIDTH * y];
+        uint8_t *optr = display.scanLine(y);
+        for(int x=0;x<FB_WIDTH;x++) {
+            optr[0] = optr[1] = optr[2] = *iptr++;
             optr+=3;
         }
-   
-    repaint();
+        ymin = qMin(ymin, y);
+        ymax = y;
+    }
+
+    // only repaint the changed band
+    if(ymax >= ymin)
+        update(QRect(0, ymin, width(), ymax - ymin + 1));
 }
 
 void OLEDWidget::set_display_on(bool on) {
@@ -148,14 +240,17 @@ void OLEDWidget::set_display_on(bool on) {
     repaint();
 }
 
-void OLEDWidget::paintEvent(QPaintEvent *) {
+void OLEDWidget::paintEvent(QPaintEvent *evt) {
     QPainter painter(this);
+    // the widget has the display size
     if(display_on)
-        painter.drawImage(QRect(0, 0, width(), height()), display, QRect(0, 0, display.width(), display.height()));
+        painter.drawImage(evt->rect(), display, evt->rect());
     else
-        painter.eraseRect(QRect(0, 0, width(), height()));
+        painter.eraseRect(evt->rect());
 }
 
+#endif
+
 // see INPUTS/inputs.c
 
 extern "C" volatile int16_t inputs_wheel_cur_increment;
@@ -205,60 +300,65 @@ extern "C" void inputs_scan(void)
     }
 }
 
+void emu_wheel_scroll(int increment)
+{
+    emu_record_event("wheel " + QByteArray::number(increment));
+    irq_mutex.lock();
+    inputs_wheel_cur_increment += increment;
+    irq_mutex.unlock();
+}
 
-void OLEDWidget::wheelEvent(QWheelEvent *evt) {
-    int delta = evt->angleDelta().y()/120;
+void emu_wheel_press(bool pressed, bool long_press)
+{
+    emu_record_event(pressed ? (long_press ? "press long" : "press") : "release");
     irq_mutex.lock();
-    inputs_wheel_cur_increment -= delta;
+    set_emulated_wheel_state(pressed, long_press ? 3000 : -1);
     irq_mutex.unlock();
 }
 
+#ifndef EMULATOR_HEADLESS
+
+// all inputs go through emu_wheel_scroll / emu_wheel_press so that they can be recorded
+void OLEDWidget::wheelEvent(QWheelEvent *evt) {
+    int delta = evt->angleDelta().y()/120;
+    if(delta != 0)
+        emu_wheel_scroll(-delta);
+}
+
 void OLEDWidget::mousePressEvent(QMouseEvent *evt) {
-    irq_mutex.lock();
     if((evt->button() == Qt::BackButton) || (evt->button() == Qt::RightButton))
-    {
-        set_emulated_wheel_state(true, 3000);
-    }
+        emu_wheel_press(true, true);
     else if(evt->button() == Qt::LeftButton)
-        set_emulated_wheel_state(true, -1);
-
-    irq_mutex.unlock();
+        emu_wheel_press(true, false);
 }
 
 void OLEDWidget::mouseReleaseEvent(QMouseEvent *evt) {
-    irq_mutex.lock();
-    if((evt->button() == Qt::BackButton) || (evt->button() == Qt::RightButton))
-        set_emulated_wheel_state(false, -1);
-    else if(evt->button() == Qt::LeftButton)
-        set_emulated_wheel_state(false, -1);
-    irq_mutex.unlock();
+    if((evt->button() == Qt::BackButton) || (evt->button() == Qt::RightButton) || (evt->button() == Qt::LeftButton))
+        emu_wheel_press(false, false);
 }
 
 void OLEDWidget::keyPressEvent(QKeyEvent *evt) {
-    irq_mutex.lock();
     switch(evt->key()) {
     case Qt::Key_Up:
-        inputs_wheel_cur_increment--;
+        emu_wheel_scroll(-1);
         break;
     case Qt::Key_Down:
-        inputs_wheel_cur_increment++;
+        emu_wheel_scroll(1);
         break;
     case Qt::Key_Right:
     case Qt::Key_Space:
     case Qt::Key_Enter:
     case Qt::Key_Return:
-        set_emulated_wheel_state(true, -1);
+        emu_wheel_press(true, false);
         break;
     case Qt::Key_Left:
     case Qt::Key_Backspace:
-        set_emulated_wheel_state(true, 3000);
+        emu_wheel_press(true, true);
         break;
     }
-    irq_mutex.unlock();
 }
 
 void OLEDWidget::keyReleaseEvent(QKeyEvent *evt) {
-    irq_mutex.lock();
     switch(evt->key()) {
     case Qt::Key_Right:
     case Qt::Key_Space:
@@ -266,9 +366,9 @@ void OLEDWidget::keyReleaseEvent(QKeyEvent *evt) {
     case Qt::Key_Return:
     case Qt::Key_Left:
     case Qt::Key_Backspace:
-        set_emulated_wheel_state(false, -1);
+        emu_wheel_press(false, false);
         break;
     }
-    irq_mutex.unlock();
-
 }
+
+#endif
@@ -4,6 +4,12 @@
 
 #ifdef __cplusplus
 
+// input injection & last flushed frame (256x64, 8-bit grayscale), returns display on state
+void emu_wheel_scroll(int increment);
+void emu_wheel_press(bool pressed, bool long_press);
+bool emu_oled_get_framebuffer(uint8_t *fb);
+
+#ifndef EMULATOR_HEADLESS
 #include <QWidget>
 #include <QImage>
 
@@ -14,7 +20,7 @@ public:
     OLEDWidget();
     ~OLEDWidget();
 
-    void update_display(const uint8_t *fb);
+    void update_display(const uint8_t *fb, uint64_t dirty_rows);
     void set_display_on(bool on);
 
 protected:
@@ -25,11 +31,13 @@ protected:
     virtual void keyPressEvent(QKeyEvent *evt);
     virtual void keyReleaseEvent(QKeyEvent *evt);
 };
+#endif
 
 extern "C" {
 #endif
 
 void emu_oled_byte(uint8_t data);
+void emu_oled_data(const uint8_t *data, uint32_t length);
 void emu_oled_flush(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,507 @@
+#include "emu_replay.h"
+#include "emulator.h"
+#include "emu_oled.h"
+#include "emu_smartcard.h"
+#include "emu_storage.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "qt_metacall_helper.h"
+
+/* Session files: one event per line, "<ms> <event> [args]" with <ms> the emulated time since the recording started:
+ *  in <hex> / out <hex>            bytes received from / sent to moolticute, one packet per "out" line
+ *  wheel <n>                       wheel scrolled by n steps
+ *  press [long] / release          wheel pressed / released
+ *  card insert <file>              smartcard file inserted
+ *  card new <type>                 blank smartcard inserted, see EMU_SMARTCARD_xxx
+ *  card remove                     smartcard removed
+ *
+ * Replays start from the flash files and smartcard the emulator is given: record and replay from the
+ * same --restore snapshot to get comparable runs.
+ * Inputs are fed back in virtual time: each one waits until the device sent as many packets as it had
+ * when the input was recorded, then for the emulated delay it had after the previous input.
+ */
+
+// emulated ms the device is given to answer before the replay carries on regardless
+#define REPLAY_ANSWER_TIMEOUT   30000
+
+/****************************************************************************/
+/* Recording                                                                */
+/****************************************************************************/
+
+static QMutex record_mutex;
+static QFile record_file;
+static uint64_t record_start;
+static std::atomic<bool> recording(false);
+
+bool emu_record_start(const QString & file_name)
+{
+    QMutexLocker locker(&record_mutex);
+
+    record_file.setFileName(file_name);
+    if(!record_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    record_start = emu_get_ms_ticks();
+    recording = true;
+    return true;
+}
+
+void emu_record_stop(void)
+{
+    QMutexLocker locker(&record_mutex);
+    recording = false;
+    record_file.close();
+}
+
+void emu_record_event(const QByteArray & event)
+{
+    if(!recording)
+        return;
+
+    // written through right away: the session is kept if the emulator is killed
+    QMutexLocker locker(&record_mutex);
+    record_file.write(QByteArray::number((qulonglong)(emu_get_ms_ticks() - record_start)) + ' ' + event + '\n');
+    record_file.flush();
+}
+
+void emu_record_hid(bool incoming, const char *data, int size)
+{
+    if(recording)
+        emu_record_event((incoming ? "in " : "out ") + QByteArray(data, size).toHex());
+}
+
+/****************************************************************************/
+/* Replay                                                                   */
+/****************************************************************************/
+
+enum { REPLAY_IN, REPLAY_WHEEL, REPLAY_PRESS, REPLAY_RELEASE, REPLAY_CARD_INSERT, REPLAY_CARD_NEW, REPLAY_CARD_REMOVE };
+
+struct replay_event_t {
+    int type;
+    uint64_t delay;         // emulated ms since the previous input
+    int packets_before;     // packets sent by the device before this input was recorded
+    int value;
+    QByteArray data;
+};
+
+static QVector<replay_event_t> replay_events;
+static int replay_final_packets;
+static bool replay_active = false;
+
+// firmware thread only
+static int replay_next;
+static int replay_packets_sent;
+static uint64_t replay_last_tick;
+static bool replay_started = false;
+static bool replay_done = false;
+static bool replay_diverged = false;
+static QByteArray replay_pending;
+
+bool emu_replay_load(const QString & file_name)
+{
+    QFile file(file_name);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Replay: can't open" << file_name;
+        return false;
+    }
+
+    uint64_t last_input = 0;
+    int packets = 0;
+    int line_nb = 0;
+
+    while(!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        QList<QByteArray> args = line.split(' ');
+        line_nb++;
+
+        if(line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        bool ok = false;
+        uint64_t timestamp = args[0].toULongLong(&ok);
+        if(!ok || args.size() < 2 || timestamp < last_input) {
+            qWarning() << "Replay: invalid line" << line_nb << "in" << file_name;
+            return false;
+        }
+
+        const QByteArray & event = args[1];
+        replay_event_t evt;
+        evt.delay = timestamp - last_input;
+        evt.packets_before = packets;
+        evt.value = 0;
+
+        if(event == "out") {
+            packets++;
+            continue;
+
+        } else if(event == "in" && args.size() == 3) {
+            evt.type = REPLAY_IN;
+            evt.data = QByteArray::fromHex(args[2]);
+
+        } else if(event == "wheel" && args.size() == 3) {
+            evt.type = REPLAY_WHEEL;
+            evt.value = args[2].toInt(&ok);
+
+        } else if(event == "press") {
+            evt.type = REPLAY_PRESS;
+            evt.value = (args.size() > 2) && (args[2] == "long");
+
+        } else if(event == "release") {
+            evt.type = REPLAY_RELEASE;
+
+        } else if(event == "card" && args.size() > 3 && args[2] == "insert") {
+            evt.type = REPLAY_CARD_INSERT;
+            evt.data = line.mid(line.indexOf(" insert ") + 8);
+
+        } else if(event == "card" && args.size() == 4 && args[2] == "new") {
+            evt.type = REPLAY_CARD_NEW;
+            evt.value = args[3].toInt(&ok);
+
+        } else if(event == "card" && args.size() == 3 && args[2] == "remove") {
+            evt.type = REPLAY_CARD_REMOVE;
+
+        } else {
+            ok = false;
+        }
+
+        if(!ok) {
+            qWarning() << "Replay: invalid line" << line_nb << "in" << file_name;
+            return false;
+        }
+
+        replay_events.append(evt);
+        last_input = timestamp;
+    }
+
+    replay_final_packets = packets;
+    replay_active = true;
+    return true;
+}
+
+bool emu_replay_is_active(void)
+{
+    return replay_active;
+}
+
+void emu_replay_send_hid(const char *data, int size)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    replay_packets_sent++;
+}
+
+static void emu_replay_deliver(const replay_event_t & evt)
+{
+    switch(evt.type) {
+        case REPLAY_IN:
+            replay_pending = evt.data;
+            break;
+
+        case REPLAY_WHEEL:
+            emu_wheel_scroll(evt.value);
+            break;
+
+        case REPLAY_PRESS:
+            emu_wheel_press(true, evt.value != 0);
+            break;
+
+        case REPLAY_RELEASE:
+            emu_wheel_press(false, false);
+            break;
+
+        case REPLAY_CARD_INSERT:
+            if(!emu_insert_smartcard(QString::fromUtf8(evt.data))) {
+                qWarning() << "Replay: can't open smartcard file" << evt.data;
+                replay_diverged = true;
+            }
+            break;
+
+        case REPLAY_CARD_NEW:
+            emu_insert_new_smartcard(QString(), evt.value);
+            break;
+
+        case REPLAY_CARD_REMOVE:
+            emu_remove_smartcard();
+            break;
+    }
+}
+
+// true once the device sent the packets it had sent at that point of the recording, or gave up waiting
+static bool emu_replay_device_answered(int packets, uint64_t now)
+{
+    if(replay_packets_sent >= packets)
+        return true;
+
+    if(now - replay_last_tick < REPLAY_ANSWER_TIMEOUT)
+        return false;
+
+    qWarning() << "Replay: the device sent" << replay_packets_sent << "packets instead of" << packets << ", carrying on";
+    replay_packets_sent = packets;
+    replay_diverged = true;
+    return true;
+}
+
+int emu_replay_receive_hid(char *data, int size)
+{
+    uint64_t now = emu_get_ms_ticks();
+
+    if(!replay_started) {
+        replay_started = true;
+        replay_last_tick = now;
+    }
+
+    while(replay_pending.isEmpty() && replay_next < replay_events.size()) {
+        const replay_event_t & evt = replay_events[replay_next];
+
+        if(!emu_replay_device_answered(evt.packets_before, now) || now - replay_last_tick < evt.delay)
+            break;
+
+        emu_replay_deliver(evt);
+        replay_last_tick = now;
+        replay_next++;
+    }
+
+    if(!replay_done && replay_pending.isEmpty() && replay_next == replay_events.size() && emu_replay_device_answered(replay_final_packets, now)) {
+        replay_done = true;
+        postToObject([] () { QCoreApplication::quit(); }, QCoreApplication::instance());
+    }
+
+    if(replay_pending.isEmpty()) {
+        // the firmware is idle: move time forward rather than wait for the host clock
+        emu_skip_time_ms(1);
+        return 0;
+    }
+
+    int nb = qMin(size, replay_pending.size());
+    memcpy(data, replay_pending.constData(), nb);
+    replay_pending.remove(0, nb);
+    return nb;
+}
+
+/****************************************************************************/
+/* Per command costs                                                        */
+/****************************************************************************/
+
+struct cost_sample_t {
+    uint64_t cpu_ns;
+    int64_t instructions;   // -1: not available
+    uint32_t flash_reads;
+    uint32_t flash_writes;
+    uint64_t ms;
+};
+
+struct cmd_cost_t {
+    uint32_t calls = 0;
+    double cpu_us = 0;
+    double instructions = 0;
+    double flash_reads = 0;
+    double flash_writes = 0;
+    double ms = 0;
+};
+
+static QMap<uint16_t, cmd_cost_t> cmd_costs;
+static bool cmd_open = false;
+static uint16_t cmd_id;
+static cost_sample_t cmd_start_sample;
+
+/* user space instructions retired by the firmware thread, the counter is opened by the first call */
+static int64_t emu_read_instructions(void)
+{
+#ifdef Q_OS_LINUX
+    static int perf_fd = -2;
+    uint64_t count;
+
+    if(perf_fd == -2) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if(perf_fd < 0)
+            qWarning() << "Replay: no hardware instruction counter, comparing CPU time instead";
+    }
+
+    if(perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) == sizeof(count))
+        return count;
+#endif
+    return -1;
+}
+
+static cost_sample_t emu_cost_sample(void)
+{
+    cost_sample_t sample;
+
+#ifdef Q_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    sample.cpu_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    static QElapsedTimer timer;
+    if(!timer.isValid())
+        timer.start();
+    sample.cpu_ns = timer.nsecsElapsed();
+#endif
+    sample.instructions = emu_read_instructions();
+    emu_storage_get_op_counts(&sample.flash_reads, &sample.flash_writes);
+    sample.ms = emu_get_ms_ticks();
+    return sample;
+}
+
+void emu_hid_cmd_end(void)
+{
+    if(!cmd_open)
+        return;
+
+    cost_sample_t end = emu_cost_sample();
+    cmd_cost_t & cost = cmd_costs[cmd_id];
+
+    cost.calls++;
+    cost.cpu_us += (end.cpu_ns - cmd_start_sample.cpu_ns) / 1000.0;
+    if(end.instructions < 0 || cmd_start_sample.instructions < 0)
+        cost.instructions = -1;
+    else if(cost.instructions >= 0)
+        cost.instructions += end.instructions - cmd_start_sample.instructions;
+    cost.flash_reads += end.flash_reads - cmd_start_sample.flash_reads;
+    cost.flash_writes += end.flash_writes - cmd_start_sample.flash_writes;
+    cost.ms += end.ms - cmd_start_sample.ms;
+    cmd_open = false;
+}
+
+void emu_hid_cmd_start(uint16_t command)
+{
+    if(!replay_active)
+        return;
+
+    // a command without answer ends when the next one comes in
+    emu_hid_cmd_end();
+
+    cmd_id = command;
+    cmd_open = true;
+    cmd_start_sample = emu_cost_sample();
+}
+
+/****************************************************************************/
+/* Report & baseline                                                        */
+/****************************************************************************/
+
+static QByteArray emu_replay_report(void)
+{
+    QByteArray report = "command,calls,cpu_us,instructions,flash_reads,flash_writes,ms\n";
+
+    for(auto it = cmd_costs.constBegin(); it != cmd_costs.constEnd(); ++it) {
+        const cmd_cost_t & cost = it.value();
+        report += QString("0x%1,%2,%3,%4,%5,%6,%7\n").arg(it.key(), 4, 16, QChar('0')).arg(cost.calls)
+                .arg(cost.cpu_us / cost.calls, 0, 'f', 1)
+                .arg(cost.instructions < 0 ? -1.0 : cost.instructions / cost.calls, 0, 'f', 0)
+                .arg(cost.flash_reads / cost.calls, 0, 'f', 2).arg(cost.flash_writes / cost.calls, 0, 'f', 2)
+                .arg(cost.ms / cost.calls, 0, 'f', 1).toLatin1();
+    }
+
+    return report;
+}
+
+// per call averages, as written by emu_replay_report
+static bool emu_replay_load_baseline(const QString & file_name, QMap<uint16_t, cmd_cost_t> & baseline)
+{
+    QFile file(file_name);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    file.readLine();
+    while(!file.atEnd()) {
+        QList<QByteArray> fields = file.readLine().trimmed().split(',');
+        if(fields.size() != 7)
+            continue;
+
+        cmd_cost_t cost;
+        cost.calls = fields[1].toUInt();
+        cost.cpu_us = fields[2].toDouble();
+        cost.instructions = fields[3].toDouble();
+        cost.flash_reads = fields[4].toDouble();
+        cost.flash_writes = fields[5].toDouble();
+        cost.ms = fields[6].toDouble();
+        baseline[fields[0].mid(2).toUShort(nullptr, 16)] = cost;
+    }
+
+    return true;
+}
+
+// small absolute slack so that cheap commands don't fail on noise
+static bool emu_cost_regressed(uint16_t command, const char *metric, double base, double now, double threshold, double slack)
+{
+    if(now <= base * (1 + threshold / 100) || now - base <= slack)
+        return false;
+
+    fprintf(stderr, "Regression on command 0x%04x: %s %.1f -> %.1f per call\n", command, metric, base, now);
+    return true;
+}
+
+int emu_replay_finish(const QString & report_file, const QString & baseline_file, double threshold)
+{
+    QMap<uint16_t, cmd_cost_t> baseline;
+    QByteArray report = emu_replay_report();
+    bool regressed = false;
+
+    if(report_file.isEmpty()) {
+        fputs(report.constData(), stdout);
+    } else {
+        QFile file(report_file);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(report) != report.size())
+            qWarning() << "Replay: can't write the report to" << report_file;
+    }
+
+    if(!baseline_file.isEmpty()) {
+        if(!emu_replay_load_baseline(baseline_file, baseline)) {
+            qWarning() << "Replay: can't read baseline" << baseline_file;
+            return 1;
+        }
+
+        for(auto it = cmd_costs.constBegin(); it != cmd_costs.constEnd(); ++it) {
+            if(!baseline.contains(it.key()))
+                continue;
+
+            const cmd_cost_t & base = baseline[it.key()];
+            const cmd_cost_t & cost = it.value();
+            double instructions = cost.instructions / cost.calls;
+
+            // instruction counts are stable from run to run, CPU time only when they aren't available
+            if(base.instructions >= 0 && cost.instructions >= 0)
+                regressed |= emu_cost_regressed(it.key(), "instructions", base.instructions, instructions, threshold, 10000);
+            else
+                regressed |= emu_cost_regressed(it.key(), "cpu_us", base.cpu_us, cost.cpu_us / cost.calls, threshold, 50);
+
+            regressed |= emu_cost_regressed(it.key(), "flash_ops", base.flash_reads + base.flash_writes,
+                                            (cost.flash_reads + cost.flash_writes) / cost.calls, threshold, 1);
+        }
+    }
+
+    if(replay_diverged)
+        fprintf(stderr, "Replay diverged from the recorded session\n");
+
+    if(regressed)
+        return 2;
+    return replay_diverged ? 3 : 0;
+}
@@ -0,0 +1,34 @@
+#ifndef EMU_REPLAY_H
+#define EMU_REPLAY_H
+#include <inttypes.h>
+
+#ifdef __cplusplus
+#include <QString>
+#include <QByteArray>
+
+// HID session recording (--record) and replay (--replay), see emu_replay.cpp
+bool emu_record_start(const QString & file_name);
+void emu_record_stop(void);
+void emu_record_event(const QByteArray & event);
+void emu_record_hid(bool incoming, const char *data, int size);
+
+bool emu_replay_load(const QString & file_name);
+bool emu_replay_is_active(void);
+int emu_replay_finish(const QString & report_file, const QString & baseline_file, double threshold);
+
+// firmware thread side, replaces the HID link while replaying
+void emu_replay_send_hid(const char *data, int size);
+int emu_replay_receive_hid(char *data, int size);
+
+extern "C" {
+#endif
+
+// per HID command cost accounting while replaying, called by the aux MCU emulation
+void emu_hid_cmd_start(uint16_t command);
+void emu_hid_cmd_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,10 @@
 #include "emu_smartcard.h"
+#include "emu_replay.h"
 
 #include <QMutex>
 #include <QMutexLocker>
 #include <QFile>
+#include <QFileInfo>
 
 static QMutex smc_mutex;
 static emu_smartcard_t card;
@@ -45,6 +47,7 @@ bool emu_insert_smartcard(QString filePath)
     smartcardFile.read((char*)&card.storage, sizeof(card.storage));
     card_present = true;
 
+    emu_record_event("card insert " + QFileInfo(filePath).absoluteFilePath().toUtf8());
     return true;
 }
 
@@ -58,6 +61,9 @@ bool emu_insert_new_smartcard(QString filePath, int smartcard_type)
     card_present = true;
     emu_init_smartcard(&card.storage, smartcard_type);
 
+    // replayed as a blank card that isn't saved anywhere
+    emu_record_event("card new " + QByteArray::number(smartcard_type));
+
     if(!filePath.isEmpty()) {
         smartcardFile.setFileName(filePath);
         if(!smartcardFile.open(QIODevice::ReadWrite))
@@ -71,10 +77,22 @@ bool emu_insert_new_smartcard(QString filePath, int smartcard_type)
     return true;
 }
 
+bool emu_save_smartcard(QString filePath)
+{
+    QMutexLocker locker(&smc_mutex);
+    QFile copy(filePath);
+
+    if(!card_present || !copy.open(QIODevice::WriteOnly))
+        return false;
+
+    return copy.write((char*)&card.storage, sizeof(card.storage)) == sizeof(card.storage);
+}
+
 void emu_remove_smartcard() {
     QMutexLocker locker(&smc_mutex);
     smartcardFile.close();
     card_present = false;
+    emu_record_event("card remove");
 }
 
 void emu_reset_smartcard() {
@@ -32,6 +32,7 @@ void emu_reset_smartcard();
 
 bool emu_insert_smartcard(QString filePath);
 bool emu_insert_new_smartcard(QString filePath, int smartcard_type = EMU_SMARTCARD_REGULAR);
+bool emu_save_smartcard(QString filePath);
 void emu_remove_smartcard();
 bool emu_is_smartcard_inserted();
 
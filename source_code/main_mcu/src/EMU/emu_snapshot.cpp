@@ -0,0 +1,149 @@
+#include "emu_snapshot.h"
+#include "emulator.h"
+#include "emu_smartcard.h"
+extern "C" {
+#include "logic_security.h"
+}
+
+#include <atomic>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QSemaphore>
+#include <QSettings>
+
+#include "emu_storage.h"
+
+// see TIMER/driver_timer.c
+extern "C" uint32_t timer_emulator_fake_rtc_cnt;
+extern "C" uint32_t timer_last_set_timestamp;
+
+static QMutex request_mutex;
+static QString request_dir;
+static bool request_pending = false;
+static bool request_result;
+static QSemaphore request_done;
+
+// PIN given to the first PIN prompt after restoring a snapshot taken with a logged in user
+static std::atomic<bool> restore_pin_armed(false);
+
+static bool emu_snapshot_copy(const QString & from, const QString & to)
+{
+    QFile::remove(to);
+    if(!QFile::copy(from, to)) {
+        qWarning() << "Snapshot: failed to copy" << from << "to" << to;
+        return false;
+    }
+    return true;
+}
+
+bool emu_snapshot_save(const QString & dir)
+{
+    if(!QDir().mkpath(dir))
+        return false;
+
+    // the flash files are mapped shared: reading them through the file gives the current content
+    emu_storage_sync(TRUE);
+    if(!emu_snapshot_copy("eeprom.bin", dir + "/eeprom.bin") || !emu_snapshot_copy("dbflash.bin", dir + "/dbflash.bin"))
+        return false;
+
+    QFile::remove(dir + "/smartcard.bin");
+    bool smartcard_inserted = emu_is_smartcard_inserted();
+    if(smartcard_inserted && !emu_save_smartcard(dir + "/smartcard.bin"))
+        return false;
+
+    QSettings state(dir + "/snapshot.ini", QSettings::IniFormat);
+    state.clear();
+    state.setValue("rtc_counter", timer_emulator_fake_rtc_cnt);
+    state.setValue("rtc_last_set", timer_last_set_timestamp);
+    state.setValue("battery_level", emu_get_battery_level());
+    state.setValue("usb_powered", (bool)emu_get_usb_charging());
+    state.setValue("lefthanded", (bool)emu_get_lefthanded());
+    state.setValue("smartcard_inserted", smartcard_inserted);
+    state.setValue("user_logged_in", smartcard_inserted && logic_security_is_smc_inserted_unlocked() != FALSE);
+    state.sync();
+
+    return state.status() == QSettings::NoError;
+}
+
+bool emu_snapshot_restore(const QString & dir)
+{
+    QSettings state(dir + "/snapshot.ini", QSettings::IniFormat);
+    if(!QFile::exists(dir + "/snapshot.ini") || state.status() != QSettings::NoError) {
+        qWarning() << "Snapshot: no valid snapshot in" << dir;
+        return false;
+    }
+
+    // the snapshot stays untouched, the device works on copies
+    if(!emu_snapshot_copy(dir + "/eeprom.bin", "eeprom.bin") || !emu_snapshot_copy(dir + "/dbflash.bin", "dbflash.bin"))
+        return false;
+
+    if(state.value("smartcard_inserted").toBool()) {
+        if(!emu_snapshot_copy(dir + "/smartcard.bin", "smartcard.bin") || !emu_insert_smartcard("smartcard.bin"))
+            return false;
+    }
+
+    timer_emulator_fake_rtc_cnt = state.value("rtc_counter").toUInt();
+    timer_last_set_timestamp = state.value("rtc_last_set").toUInt();
+    emu_set_battery_level(state.value("battery_level", 75).toInt());
+    emu_set_usb_powered(state.value("usb_powered").toBool());
+    emu_set_lefthanded(state.value("lefthanded").toBool());
+
+    // the RAM context can't be restored as is: unlock the card again when the firmware asks for its PIN
+    restore_pin_armed = state.value("user_logged_in").toBool();
+
+    return true;
+}
+
+bool emu_snapshot_request(const QString & dir)
+{
+    request_mutex.lock();
+    request_dir = dir;
+    request_pending = true;
+    request_mutex.unlock();
+
+    if(request_done.tryAcquire(1, 5000))
+        return request_result;
+
+    // the firmware is busy: cancel, unless it just picked the request up
+    request_mutex.lock();
+    bool picked_up = !request_pending;
+    request_pending = false;
+    request_mutex.unlock();
+
+    if(picked_up) {
+        request_done.acquire();
+        return request_result;
+    }
+    return false;
+}
+
+void emu_snapshot_poll(void)
+{
+    request_mutex.lock();
+    if(!request_pending) {
+        request_mutex.unlock();
+        return;
+    }
+    request_pending = false;
+    QString dir = request_dir;
+    request_mutex.unlock();
+
+    request_result = emu_snapshot_save(dir);
+    request_done.release();
+}
+
+BOOL emu_get_restore_pin(volatile uint16_t *pin_code)
+{
+    if(!restore_pin_armed.exchange(false))
+        return FALSE;
+
+    struct emu_smartcard_t *smartcard = emu_open_smartcard();
+    if(smartcard == NULL)
+        return FALSE;
+
+    *pin_code = (smartcard->storage.smc[10] << 8) | smartcard->storage.smc[11];
+    emu_close_smartcard(FALSE);
+    return TRUE;
+}
@@ -0,0 +1,17 @@
+#ifndef EMU_SNAPSHOT_H
+#define EMU_SNAPSHOT_H
+
+#include <QString>
+
+// Device state snapshots: a directory holding eeprom.bin, dbflash.bin, smartcard.bin and
+// snapshot.ini (RTC, power & accelerometer state, logged in user), see emu_snapshot.cpp
+
+// firmware stopped or not started yet
+bool emu_snapshot_save(const QString & dir);
+bool emu_snapshot_restore(const QString & dir);
+
+// firmware running: the snapshot is taken by the firmware thread between two main loop iterations
+bool emu_snapshot_request(const QString & dir);
+void emu_snapshot_poll(void);
+
+#endif
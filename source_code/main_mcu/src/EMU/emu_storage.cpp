@@ -1,57 +1,112 @@
 #include "emu_storage.h"
 
 #include <stdlib.h>
+#include <atomic>
 #include <QDebug>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
 
-static QFile eeprom("eeprom.bin");
-static QFile dbflash("dbflash.bin");
-static bool emu_open_flash(QFile & flashFile)
+/* Emulated flash: mapped in memory when possible, read / written through the file otherwise */
+struct emu_flash_t {
+    QFile file;
+    uchar *map;
+    int size;
+    std::atomic<bool> dirty;
+    std::atomic<uint32_t> reads;
+    std::atomic<uint32_t> writes;
+
+    emu_flash_t(const char *name): file(name), map(nullptr), size(0), dirty(false), reads(0), writes(0) {}
+};
+
+static emu_flash_t eeprom("eeprom.bin");
+static emu_flash_t dbflash("dbflash.bin");
+static QMutex storage_mutex;
+
+static bool emu_open_flash(emu_flash_t & flash, int size)
 {
-    if(!flashFile.open(QIODevice::ReadWrite)) {
-        qWarning() << "Failed to open emulated flash" << flashFile.fileName();
+    QMutexLocker locker(&storage_mutex);
+
+    if(!flash.file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open emulated flash" << flash.file.fileName();
         abort();
     }
 
-    return flashFile.size() > 0;
+    bool has_content = flash.file.size() > 0;
+
+    /* Pre-size the file to the full flash size, erased */
+    if(flash.file.size() < size) {
+        flash.file.seek(flash.file.size());
+        flash.file.write(QByteArray(size - flash.file.size(), '\xff'));
+        flash.file.flush();
+    }
+    flash.size = size;
+
+    /* Map it: accesses are then memcpys, durability is handled by emu_storage_sync */
+    flash.map = flash.file.map(0, size);
+    if(flash.map == nullptr) {
+        qWarning() << "Failed to map emulated flash" << flash.file.fileName() << ", falling back to file accesses";
+    }
+
+    return has_content;
 }
 
-static void emu_extend_flash(QFile & flashFile, int size)
+static void emu_flash_read(emu_flash_t & flash, int offset, uint8_t *buf, int length)
 {
-    if(flashFile.size() < size) {
-        flashFile.seek(flashFile.size());
-        int extend_size = size - flashFile.size();
-        flashFile.write(QByteArray(extend_size, '\xff'));
+    flash.reads++;
+
+    if(!flash.file.isOpen() || offset < 0 || offset + length > flash.size) {
+        memset(buf, 0xff, length);
+
+    } else if(flash.map != nullptr) {
+        memcpy(buf, flash.map + offset, length);
+
+    } else {
+        QMutexLocker locker(&storage_mutex);
+        flash.file.seek(offset);
+        flash.file.read((char*)buf, length);
     }
-    
-    flashFile.flush();
 }
 
-static void emu_flash_read(QFile & flashFile, int offset, uint8_t *buf, int length) 
+static void emu_flash_write(emu_flash_t & flash, int offset, uint8_t *buf, int length)
 {
-    if(flashFile.isOpen()) {
-        emu_extend_flash(flashFile, offset+length);
-        flashFile.seek(offset);
-        flashFile.read((char*)buf, length);
+    flash.writes++;
+
+    if(!flash.file.isOpen() || offset < 0 || offset + length > flash.size) {
+        qWarning() << "Out of bounds write to emulated flash" << flash.file.fileName() << offset << length;
+
+    } else if(flash.map != nullptr) {
+        memcpy(flash.map + offset, buf, length);
+        flash.dirty = true;
 
     } else {
-        memset(buf, 0xff, length);
+        QMutexLocker locker(&storage_mutex);
+        flash.file.seek(offset);
+        flash.file.write((char*)buf, length);
+        flash.dirty = true;
     }
 }
 
-static void emu_flash_write(QFile & flashFile, int offset, uint8_t *buf, int length)
+static void emu_flash_sync(emu_flash_t & flash, bool blocking)
 {
-    if(flashFile.isOpen()) {
-        emu_extend_flash(flashFile, offset+length);
-        flashFile.seek(offset);
-        flashFile.write((char*)buf, length);
-        flashFile.flush();
+    if(!flash.dirty.exchange(false))
+        return;
+
+    if(flash.map != nullptr) {
+#ifdef Q_OS_UNIX
+        msync(flash.map, flash.size, blocking ? MS_SYNC : MS_ASYNC);
+#endif
+    } else {
+        flash.file.flush();
     }
 }
 
-BOOL emu_eeprom_open()
+BOOL emu_eeprom_open(int size)
 {
-    return emu_open_flash(eeprom);
+    return emu_open_flash(eeprom, size);
 }
 
 void emu_eeprom_read(int offset, uint8_t *buf, int length)
@@ -64,9 +119,9 @@ void emu_eeprom_write(int offset, uint8_t *buf, int length)
     return emu_flash_write(eeprom, offset, buf, length);
 }
 
-BOOL emu_dbflash_open()
+BOOL emu_dbflash_open(int size)
 {
-    return emu_open_flash(dbflash);
+    return emu_open_flash(dbflash, size);
 }
 
 void emu_dbflash_read(int offset, uint8_t *buf, int length)
@@ -79,3 +134,15 @@ void emu_dbflash_write(int offset, uint8_t *buf, int length)
     return emu_flash_write(dbflash, offset, buf, length);
 }
 
+void emu_storage_sync(BOOL blocking)
+{
+    QMutexLocker locker(&storage_mutex);
+    emu_flash_sync(eeprom, blocking);
+    emu_flash_sync(dbflash, blocking);
+}
+
+void emu_storage_get_op_counts(uint32_t *reads, uint32_t *writes)
+{
+    *reads = eeprom.reads + dbflash.reads;
+    *writes = eeprom.writes + dbflash.writes;
+}
@@ -7,14 +7,19 @@
 extern "C" {
 #endif
 
-BOOL emu_eeprom_open(void);
+BOOL emu_eeprom_open(int size);
 void emu_eeprom_read(int offset, uint8_t *buf, int length);
 void emu_eeprom_write(int offset, uint8_t *buf, int length);
 
-BOOL emu_dbflash_open(void);
+BOOL emu_dbflash_open(int size);
 void emu_dbflash_read(int offset, uint8_t *buf, int length);
 void emu_dbflash_write(int offset, uint8_t *buf, int length);
 
+void emu_storage_sync(BOOL blocking);
+
+/* number of eeprom + dbflash accesses since start, for profiling */
+void emu_storage_get_op_counts(uint32_t *reads, uint32_t *writes);
+
 #ifdef __cplusplus
 }
 #endif
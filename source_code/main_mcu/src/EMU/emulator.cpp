@@ -6,27 +6,55 @@ extern "C" {
 #include "logic_power.h"
 }
 
+#ifdef EMULATOR_HEADLESS
+#include <QCoreApplication>
+#else
 #include <QApplication>
+#include <QWidget>
+#endif
 #include <QThread>
 #include <QTimer>
-#include <QWidget>
 #include <QSemaphore>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QTime>
-#include <QLocalSocket>
 #include <QCommandLineParser>
 #include <QElapsedTimer>
+#include <QDir>
+#include <QDebug>
+#include <atomic>
 
 #include "emu_oled.h"
 #include "emu_smartcard.h"
 #include "emu_dataflash.h"
+#include "emu_storage.h"
+#include "emu_hid_link.h"
+#include "emu_snapshot.h"
+#include "emu_replay.h"
+#ifdef EMULATOR_HEADLESS
+#include "emu_headless.h"
+#else
 #include "emulator_ui.h"
+#endif
 
 static struct emu_port_t _PORT;
 struct emu_port_t *PORT=&_PORT;
 
 QMutex irq_mutex;
 
+// Virtual clock (--speed / --virtual-time): when enabled the emulated ms ticks are decoupled from the
+// host clock, systick is derived from the number of ticks and blocking delays jump to their deadline
+static bool clock_virtual = false;
+static bool clock_skip_delays = false;
+static double clock_speed = 1.0;
+static std::atomic<uint64_t> clock_ticks(0);
+
+// Idle yield (disabled by --no-idle-yield): when the firmware polls with nothing pending, its
+// thread sleeps until the next tick or incoming HID data instead of spinning on a host core
+static bool idle_yield = true;
+static QMutex tick_mutex;
+static QWaitCondition tick_cond;
+
 void cpu_irq_enter_critical(void)
 {
     irq_mutex.lock();
@@ -48,7 +76,41 @@ static void pseudo_irq(void)
     /* Power logic */
     logic_power_ms_tick();
 
+    clock_ticks++;
     irq_mutex.unlock();
+
+    tick_cond.wakeAll();
+}
+
+void emu_idle_wait(void)
+{
+    if(!idle_yield)
+        return;
+
+    // a missed wake up only costs the timeout
+    tick_mutex.lock();
+    tick_cond.wait(&tick_mutex, 2);
+    tick_mutex.unlock();
+}
+
+void emu_idle_wake(void)
+{
+    tick_cond.wakeAll();
+}
+
+uint64_t emu_get_ms_ticks(void)
+{
+    return clock_ticks;
+}
+
+void emu_skip_time_ms(uint32_t ms)
+{
+    if(!clock_skip_delays)
+        return;
+
+    // called by the firmware thread while it has nothing to do but wait: run the ticks right away
+    while(ms-- > 0)
+        pseudo_irq();
 }
 
 extern "C" void minible_main();
@@ -59,20 +121,8 @@ private:
     bool app_exiting = false;
     QSemaphore app_thread_blocked;
 
-    QLocalSocket *hid;
-
-    bool reconnect_hid() {
-        if(hid->state() != QLocalSocket::ConnectedState) {
-            hid->connectToServer("moolticuted_local_dev");
-            hid->waitForConnected(10);
-        }
-        
-        return hid->state() == QLocalSocket::ConnectedState;
-    }
-
 public:
     void run() {
-        hid = new QLocalSocket;
         minible_main();
     }
 
@@ -95,29 +145,35 @@ public:
     }
 
     void send_hid(char *data, int size) {
-        if(!reconnect_hid())
+        if(emu_replay_is_active()) {
+            emu_replay_send_hid(data, size);
             return;
-
-        while(size > 0) {
-            int nb = hid->write(data, size);
-            if(nb <= 0)
-                break;
-
-            data += nb;
-            size -= nb;
-
-            while(hid->bytesToWrite() > 0 && hid->state() == QLocalSocket::ConnectedState)
-                hid->waitForBytesWritten();
         }
+
+        emu_record_hid(false, data, size);
+        emu_hid_link_send(data, size);
     }
 
     int rcv_hid(char *data, int size) {
         test_stop();
-        if(!reconnect_hid())
+        // polled between main loop iterations: a consistent point to take a snapshot
+        emu_snapshot_poll();
+        if(emu_replay_is_active())
+            return emu_replay_receive_hid(data, size);
+
+        if(!emu_hid_link_is_connected()) {
+            emu_idle_wait();
             return -1;
+        }
 
-        hid->waitForReadyRead(0);
-        int nb = hid->read(data, size);
+        int nb = emu_hid_link_receive(data, size);
+        if(nb == 0) {
+            // nothing pending: sleep until data arrives or a tick is due rather than spinning
+            emu_idle_wait();
+            nb = emu_hid_link_receive(data, size);
+        }
+        if(nb > 0)
+            emu_record_hid(true, data, nb);
         return nb > 0 ? nb : 0;
     }
 };
@@ -148,7 +204,7 @@ BOOL emu_get_systick(uint32_t *value)
 {
     systick_mutex.lock();
     // milliseconds to 48MHz ticks
-    uint64_t systick = systick_timer.elapsed() * (uint64_t)48000;
+    uint64_t systick = (clock_virtual ? clock_ticks.load() : systick_timer.elapsed()) * (uint64_t)48000;
     BOOL wrapped = FALSE;
     if((systick & 0xffffff) != (last_systick & 0xffffff))
         wrapped = TRUE;
@@ -165,7 +221,11 @@ int main(int ac, char ** av)
     // Qt needs to run on the main thread. We run the application code on a separate thread
     // (1) to ensure responsiveness when the main code blocks
     // (2) to have our input behave in an interrupt-like manner
+#ifdef EMULATOR_HEADLESS
+    QCoreApplication app(ac, av);
+#else
     QApplication app(ac, av);
+#endif
 
     // ensure that the calendar works in UTC, so that time doesn't shift unpredictably
     qputenv("TZ", "");
@@ -176,45 +236,145 @@ int main(int ac, char ** av)
     parser.addHelpOption();
 
     parser.addOption(QCommandLineOption("smartcard", "Smartcard file to be used at startup", "smartcard"));
+    parser.addOption(QCommandLineOption("new-smartcard", "Blank smartcard file to be created and used at startup", "smartcard"));
     parser.addOption(QCommandLineOption("bundle", "Specify path to bundle.img file", "bundle"));
+    parser.addOption(QCommandLineOption("storage-sync-interval", "Interval in ms at which emulated flash changes are written back to disk, 0 to only do it on exit", "ms", "1000"));
+    parser.addOption(QCommandLineOption("restore", "Start from the device state snapshot in this directory", "dir"));
+    parser.addOption(QCommandLineOption("snapshot-on-exit", "Save the device state to this directory on exit", "dir"));
+    parser.addOption(QCommandLineOption("hid-socket", "Local socket name the emulated device connects to", "name", "moolticuted_local_dev"));
+    parser.addOption(QCommandLineOption("instance-dir", "Directory holding this device's eeprom.bin and dbflash.bin, created if needed. Allows running several emulators side by side", "dir"));
+    parser.addOption(QCommandLineOption("speed", "Emulated time speed multiplier, eg 10 to run timeouts and animations 10 times faster", "factor", "1"));
+    parser.addOption(QCommandLineOption("no-idle-yield", "Keep the firmware thread spinning when it polls with nothing to do"));
+    parser.addOption(QCommandLineOption("virtual-time", "Don't wait in firmware delays, jump straight to their deadline"));
+    parser.addOption(QCommandLineOption("record", "Record the HID traffic and user inputs of this session to a file", "file"));
+    parser.addOption(QCommandLineOption("replay", "Replay a recorded session in virtual time instead of connecting to moolticute, then exit", "file"));
+    parser.addOption(QCommandLineOption("replay-report", "File the per HID command costs of the replay are written to, stdout if not set", "file"));
+    parser.addOption(QCommandLineOption("replay-baseline", "Report of a previous replay: exit with code 2 if a command got more expensive", "file"));
+    parser.addOption(QCommandLineOption("replay-threshold", "Cost increase in percent tolerated against the baseline", "percent", "10"));
+#ifdef EMULATOR_HEADLESS
+    parser.addOption(QCommandLineOption("control-socket", "Local socket name on which control commands are accepted, in addition to stdin", "name"));
+#endif
     parser.process(app);
 
+    clock_speed = parser.value("speed").toDouble();
+    if(clock_speed <= 0)
+        clock_speed = 1.0;
+    idle_yield = !parser.isSet("no-idle-yield");
+    // replays run in virtual time: they wait for the device, never for the host clock
+    clock_skip_delays = parser.isSet("virtual-time") || parser.isSet("replay");
+    clock_virtual = clock_skip_delays || clock_speed != 1.0;
+
+    // replays only move time forward through emu_skip_time_ms (idle polls and delays), so that
+    // their ticks don't depend on how fast the host runs the firmware thread
     QTimer ms_timer;
     ms_timer.setInterval(1);
-    ms_timer.start();
+    if(!parser.isSet("replay"))
+        ms_timer.start();
 
     QObject::connect(&ms_timer, &QTimer::timeout, [] () {
-        if (true)
-        {
+        if(!clock_virtual) {
             pseudo_irq();
+            return;
         }
-        else
-        {
-            // the OS will most likely not schedule our timer with 1ms frequency,
-            // so we correct for this by running the "irq" function several times if needed
-            static QElapsedTimer timer;
-            for(int msPassed = timer.restart(); msPassed >= 0; --msPassed)
-                pseudo_irq();
-        }
+
+        // the OS will most likely not schedule our timer with 1ms frequency,
+        // so we correct for this by running the "irq" function as many times as the scaled elapsed time requires
+        static QElapsedTimer timer;
+        static double ticks_due = 0;
+        if(timer.isValid())
+            ticks_due += timer.nsecsElapsed() * clock_speed / 1000000.0;
+        timer.start();
+
+        // don't try to catch up after the process was suspended
+        int nb_ticks = (int)ticks_due;
+        ticks_due -= nb_ticks;
+        for(nb_ticks = qMin(nb_ticks, 1000); nb_ticks > 0; nb_ticks--)
+            pseudo_irq();
     });
 
+    // emulated flash files are memory mapped: write changes back periodically rather than at each access
+    QTimer storage_sync_timer;
+    int storage_sync_interval = parser.value("storage-sync-interval").toInt();
+    if(storage_sync_interval > 0) {
+        storage_sync_timer.setInterval(storage_sync_interval);
+        storage_sync_timer.start();
+    }
+
+    QObject::connect(&storage_sync_timer, &QTimer::timeout, [] () {
+        emu_storage_sync(FALSE);
+    });
+
+#ifndef EMULATOR_HEADLESS
     oled = new OLEDWidget;
+#endif
 
     if(parser.isSet("smartcard"))
         emu_insert_smartcard(parser.value("smartcard"));
+    else if(parser.isSet("new-smartcard"))
+        emu_insert_new_smartcard(parser.value("new-smartcard"));
 
     emu_dataflash_init(parser.value("bundle").toUtf8().constData());
 
+    // snapshot paths are relative to the directory the emulator was started from
+    QString restore_dir = parser.isSet("restore") ? QDir().absoluteFilePath(parser.value("restore")) : QString();
+    QString snapshot_dir = parser.isSet("snapshot-on-exit") ? QDir().absoluteFilePath(parser.value("snapshot-on-exit")) : QString();
+
+    // all firmware state lives in this process: separate devices are separate processes, each with
+    // its own flash files (opened relative to the working directory) and its own HID socket
+    if(parser.isSet("instance-dir")) {
+        QString instance_dir = parser.value("instance-dir");
+        if(!QDir().mkpath(instance_dir) || !QDir::setCurrent(instance_dir)) {
+            qCritical() << "Can't use instance directory" << instance_dir;
+            return 1;
+        }
+    }
+
+    // restored after switching to the instance directory, it provides the files the device works on
+    if(!restore_dir.isEmpty() && !emu_snapshot_restore(restore_dir))
+        return 1;
+
+    if(parser.isSet("record") && parser.isSet("replay")) {
+        qCritical() << "Can't record and replay at the same time";
+        return 1;
+    }
+
+    if(parser.isSet("replay")) {
+        if(!emu_replay_load(parser.value("replay")))
+            return 1;
+    } else {
+        emu_hid_link_start(parser.value("hid-socket"));
+    }
+
+    if(parser.isSet("record") && !emu_record_start(parser.value("record"))) {
+        qCritical() << "Can't write to" << parser.value("record");
+        return 1;
+    }
+
+#ifdef EMULATOR_HEADLESS
+    // no UI: wheel, smartcard and power events come from the control channel
+    emu_headless_init(parser.value("control-socket"));
+#else
     EmuWindow emu_window;
     emu_window.show();
 
     oled->show();
+#endif
     app_thread.start();
 
-    app.exec();
+    int ret = app.exec();
 
     app_thread.stop();
-
+    emu_record_stop();
+    if(emu_replay_is_active())
+        ret = emu_replay_finish(parser.value("replay-report"), parser.value("replay-baseline"), parser.value("replay-threshold").toDouble());
+    else
+        emu_hid_link_stop();
+    if(!snapshot_dir.isEmpty() && !emu_snapshot_save(snapshot_dir))
+        qWarning() << "Failed to save the device state to" << snapshot_dir;
+    emu_storage_sync(TRUE);
+
+#ifndef EMULATOR_HEADLESS
     delete oled;
-    return 0;
+#endif
+    return ret;
 }
@@ -21,12 +21,23 @@ int emu_rcv_hid(char *data, int size);
 int emu_get_battery_level(void);
 BOOL emu_get_usb_charging(void);
 void emu_charger_enable(BOOL en);
+void emu_set_battery_level(int level);
+void emu_set_usb_powered(BOOL powered);
+BOOL emu_is_battery_charging(void);
 
 BOOL emu_get_systick(uint32_t *value);
+uint64_t emu_get_ms_ticks(void);
+void emu_skip_time_ms(uint32_t ms);
+void emu_idle_wait(void);
+void emu_idle_wake(void);
+
+BOOL emu_get_restore_pin(volatile uint16_t *pin_code);
 
 BOOL emu_get_lefthanded(void);
+void emu_set_lefthanded(BOOL lefthanded);
 
 int emu_get_failure_flags(void);
+void emu_set_failure_flags(int flags);
 /* Keep this in sync with EmuWindow::createFailuresUi */
 enum {
     EMU_FAIL_SMARTCARD_INSECURE=1,
@@ -1,3 +1,6 @@
+#include <QMutex>
+#include <QTimer>
+#ifndef EMULATOR_HEADLESS
 #include "emulator_ui.h"
 
 #include <QFormLayout>
@@ -7,12 +10,12 @@
 #include <QMenu>
 #include <QFileDialog>
 #include <QCheckBox>
-#include <QMutex>
-#include <QTimer>
+#endif
 
 #include "emulator.h"
 #include "emu_smartcard.h"
 
+#ifndef EMULATOR_HEADLESS
 EmuWindow::EmuWindow()
 {
     auto layout = new QFormLayout(this);
@@ -101,6 +104,7 @@ QWidget *EmuWindow::createSmartcardUi()
 
     return row_smartcard;
 }
+#endif
 
 static QMutex ui_mutex;
 static int battery_level = 75;
@@ -130,6 +134,29 @@ void emu_charger_enable(BOOL en)
     ui_mutex.unlock();
 }
 
+void emu_set_battery_level(int level)
+{
+    ui_mutex.lock();
+    battery_level = qBound(0, level, 100);
+    ui_mutex.unlock();
+}
+
+void emu_set_usb_powered(BOOL powered)
+{
+    ui_mutex.lock();
+    usb_powered = powered;
+    ui_mutex.unlock();
+}
+
+BOOL emu_is_battery_charging()
+{
+    ui_mutex.lock();
+    bool ret = usb_charging && usb_powered;
+    ui_mutex.unlock();
+    return ret;
+}
+
+#ifndef EMULATOR_HEADLESS
 QWidget *EmuWindow::createBatteryUi() 
 {
     auto slider = new QSlider(Qt::Horizontal);
@@ -166,6 +193,7 @@ QWidget *EmuWindow::createChargerUi()
     });
     return checkbox;
 }
+#endif
 
 static bool left_handed = false;
 BOOL emu_get_lefthanded()
@@ -176,6 +204,14 @@ BOOL emu_get_lefthanded()
     return ret;
 }
 
+void emu_set_lefthanded(BOOL lefthanded)
+{
+    ui_mutex.lock();
+    left_handed = lefthanded;
+    ui_mutex.unlock();
+}
+
+#ifndef EMULATOR_HEADLESS
 QWidget *EmuWindow::createAccelerometerUi()
 {
     auto checkbox = new QCheckBox("left-handed");
@@ -188,6 +224,7 @@ QWidget *EmuWindow::createAccelerometerUi()
     return checkbox;
 
 }
+#endif
 
 static int failure_flags = 0;
 
@@ -199,6 +236,14 @@ int emu_get_failure_flags()
     return ret;
 }
 
+void emu_set_failure_flags(int flags)
+{
+    ui_mutex.lock();
+    failure_flags = flags;
+    ui_mutex.unlock();
+}
+
+#ifndef EMULATOR_HEADLESS
 QWidget *EmuWindow::createFailuresUi()
 {
     auto col_failures = new QWidget(this);
@@ -229,3 +274,4 @@ QWidget *EmuWindow::createFailuresUi()
 
     return col_failures;
 }
+#endif
@@ -88,6 +88,11 @@ void bitstream_bitmap_init(bitstream_bitmap_t* bs, bitmap_t* bitmap, custom_fs_a
         bs->bufInd = sizeof(bs->buf[0]);
         bs->_dma_transfer = FALSE;
     #endif
+    
+    /* Emulator: read straight from the memory mapped bundle */
+    #ifdef EMULATOR_BUILD
+        bs->_direct_data = custom_fs_get_direct_flash_pointer(address, bs->_size);
+    #endif
 }
 
 /*! \fn     bitstream_glyph_bitmap_init(bitstream_bitmap_t* bs, font_header_t* font, font_glyph_t* glyph, custom_fs_address_t address, BOOL exclusive)
@@ -153,6 +158,11 @@ void bitstream_glyph_bitmap_init(bitstream_bitmap_t* bs, font_header_t* font, fo
         bs->bufInd = sizeof(bs->buf[0]);
         bs->_dma_transfer = FALSE;
     #endif
+    
+    /* Emulator: read straight from the memory mapped bundle */
+    #ifdef EMULATOR_BUILD
+        bs->_direct_data = custom_fs_get_direct_flash_pointer(address, bs->_size);
+    #endif
 }
 
 /*! \fn     bitstream_bitmap_get_next_byte(bitstream_bitmap_t* bs)
@@ -165,6 +175,14 @@ static inline uint8_t bitstream_bitmap_get_next_byte(bitstream_bitmap_t* bs)
     /* Check if didn't read too much data */
     if (bs->_count < bs->_size) 
     {
+        /* Emulator: no need to go through our read-ahead buffer */
+        #ifdef EMULATOR_BUILD
+            if (bs->_direct_data != 0)
+            {
+                return bs->_direct_data[bs->_count++];
+            }
+        #endif
+        
         /* Increment read counter */
         bs->_count++;
         
@@ -46,6 +46,9 @@ typedef struct
     uint32_t bufSel;            //*< specify which of the 2 buffers we're using
     BOOL _exclusive_transfer;   //*< boolean to specify if no other bitmap transfer will take place at the same time
     BOOL _dma_transfer;         //*< boolean to specify if we're using DMA transfers (only convenient for big bitmaps)
+#ifdef EMULATOR_BUILD
+    const uint8_t* _direct_data; //*< emulator: pointer to the memory mapped bitmap data, when available
+#endif
 } bitstream_bitmap_t;
 
 /* Prototypes */
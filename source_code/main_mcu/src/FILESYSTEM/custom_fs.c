@@ -35,6 +35,7 @@
 #include "rng.h"
 
 #ifdef EMULATOR_BUILD
+#include "emu_dataflash.h"
 #include "emu_storage.h"
 #include "emulator.h"
 #endif
@@ -238,6 +239,28 @@ RET_TYPE custom_fs_read_from_flash(uint8_t* datap, custom_fs_address_t address,
     return RETURN_OK;
 }
 
+#ifdef EMULATOR_BUILD
+/*! \fn     custom_fs_get_direct_flash_pointer(custom_fs_address_t address, uint32_t size)
+*   \brief  Get a pointer to data in the external flash, to be read without copying it
+*   \param  address     Where the data is
+    \param  size        How many bytes will be read
+*   \return Pointer to the data, 0 if not available
+*   \note   Emulator only: the bundle image is memory mapped
+*/
+const uint8_t* custom_fs_get_direct_flash_pointer(custom_fs_address_t address, uint32_t size)
+{
+    /* Check for emergency font file exception */
+    if ((address >= CUSTOM_FS_EMERGENCY_FONT_FILE_ADDR) && (size <= sizeof(custom_fs_emergency_font_file)) && ((address-CUSTOM_FS_EMERGENCY_FONT_FILE_ADDR) + size <= sizeof(custom_fs_emergency_font_file)))
+    {
+        return &custom_fs_emergency_font_file[address-CUSTOM_FS_EMERGENCY_FONT_FILE_ADDR];
+    }
+    else
+    {
+        return emu_dataflash_get_pointer(address, size);
+    }
+}
+#endif
+
 /*! \fn     custom_fs_get_other_data_from_continuous_read_from_flash(uint8_t* datap, uint32_t size, BOOL use_dma)
 *   \brief  Get another chunk of data from continuous read from flash
 *   \param  datap       Pointer to where to store the data
@@ -1100,7 +1123,7 @@ static uint8_t eeprom[256 * 128];
 
 static void custom_fs_init_custom_storage_slots(void)
 {
-    if(!emu_eeprom_open())
+    if(!emu_eeprom_open(sizeof(eeprom)))
         custom_fs_hard_reset_settings();
 
     emu_eeprom_read(0, eeprom, sizeof(eeprom));
@@ -94,6 +94,11 @@ uint8_t* custom_fs_get_custom_ble_name(void);
 void custom_fs_hard_reset_settings(void);
 ret_type_te custom_fs_init(void);
 
+/* Emulator: bundle is memory mapped */
+#ifdef EMULATOR_BUILD
+const uint8_t* custom_fs_get_direct_flash_pointer(custom_fs_address_t address, uint32_t size);
+#endif
+
 /* Global vars, for debug only */
 #if defined(DEBUG_MENU_ENABLED)
     extern custom_file_flash_header_t custom_fs_flash_header;
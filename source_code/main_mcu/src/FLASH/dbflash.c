@@ -525,6 +525,30 @@ void dbflash_write_buffer(spi_flash_descriptor_t* descriptor_pt, uint8_t* datap,
     dbflash_wait_for_not_busy(descriptor_pt);
 }
 
+/*! \fn     dbflash_write_data_to_internal_buffer(spi_flash_descriptor_t* descriptor_pt, uint16_t offset, uint16_t dataSize, void *data)
+*   \brief  Write data into the internal memory buffer, without overwriting the provided data
+*   \param  descriptor_pt   Pointer to dbflash descriptor
+*   \param  offset          Offset to start writing to in the internal memory buffer
+*   \param  dataSize        The number of bytes to write
+*   \param  data            Pointer to the data to write
+*   \note   Use dbflash_flash_write_buffer_to_page() to program the buffer into a page
+*/
+void dbflash_write_data_to_internal_buffer(spi_flash_descriptor_t* descriptor_pt, uint16_t offset, uint16_t dataSize, void *data)
+{
+    #ifdef DBFLASH_MEMORY_BOUNDARY_CHECKS
+        // Error check the parameters offset and dataSize
+        if((offset + dataSize) > BYTES_PER_PAGE)
+        {
+            dbflash_memory_boundary_error_callblack();
+        }
+    #endif
+    
+    uint8_t opcode[4] = {DBFLASH_OPCODE_BUF_WRITE};
+    dbflash_fill_page_read_write_erase_opcode_from_address(0, offset, &opcode[1]);
+    dbflash_send_data_with_four_bytes_opcode_no_readback(descriptor_pt, opcode, data, dataSize);
+    dbflash_wait_for_not_busy(descriptor_pt);
+}
+
 /*! \fn     dbflash_flash_write_buffer_to_page(spi_flash_descriptor_t* descriptor_pt, uint16_t page)
 *   \brief  write the contents of the internal memory buffer to a page in flash
 *   \param  descriptor_pt   Pointer to dbflash descriptor
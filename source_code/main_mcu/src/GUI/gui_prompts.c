@@ -38,6 +38,9 @@
 #include "utils.h"
 #include "main.h"
 #include "rng.h"
+#ifdef EMULATOR_BUILD
+#include "emulator.h"
+#endif
 // Text Y positions for conf prompt
 const uint8_t gui_prompts_conf_prompt_y_positions[4][4] = {
     {4, 0, 0, 0},
@@ -892,7 +895,7 @@ wheel_action_ret_te gui_prompts_render_pin_enter_screen(uint8_t* current_pin, ui
         
         /* Wait for a possible ongoing previous flush */
         #ifdef OLED_INTERNAL_FRAME_BUFFER
-        oled_check_for_flush_and_terminate(&plat_oled_descriptor);
+        oled_wait_for_frame_buffer_availability(&plat_oled_descriptor);
         #endif
         
         /* Erase overwritten part */
@@ -1132,6 +1135,14 @@ RET_TYPE gui_prompts_get_user_pin(volatile uint16_t* pin_code, uint16_t stringID
     }
     #endif
     
+    #ifdef EMULATOR_BUILD
+    /* Restored emulator snapshot taken with a logged in user: unlock the card again without prompting */
+    if ((stringID == INSERT_PIN_TEXT_ID) && (emu_get_restore_pin(pin_code) != FALSE))
+    {
+        return RETURN_OK;
+    }
+    #endif
+    
     BOOL random_pin_feature_enabled = (BOOL)custom_fs_settings_get_device_setting(SETTING_RANDOM_PIN_ID);
     BOOL show_pin_entry = ((BOOL)custom_fs_settings_get_device_setting(SETTINGS_PARANOID_PIN_ENTRY) != FALSE) ? FALSE : TRUE;
     wheel_action_ret_te detection_during_animation = WHEEL_ACTION_NONE;
@@ -27,6 +27,158 @@
 #include "utils.h"
 
 
+/*! \fn     logic_database_get_prev_2_fletters_services_from_index(uint16_t start_position, uint16_t nb_entries, cust_char_t start_char, cust_char_t* char_array, uint16_t credential_type_id)
+*   \brief  Get the previous 2 services with different first letters, using the service index
+*   \param  start_position      Service index position at which we should start looking
+*   \param  nb_entries          Number of service index entries for that credential type
+*   \param  start_char          The current first char
+*   \param  char_array          An array for 2 chars
+*   \param  credential_type_id  Credential type ID
+*   \return Address of the next node having a different first letter
+*   \note   Same logic as logic_database_get_prev_2_fletters_services, only reading a first letter when it changes
+*/
+static uint16_t logic_database_get_prev_2_fletters_services_from_index(uint16_t start_position, uint16_t nb_entries, cust_char_t start_char, cust_char_t* char_array, uint16_t credential_type_id)
+{
+    uint16_t last_seen_parent_node_that_fits_category = NODE_ADDR_NULL;
+    uint16_t return_value = NODE_ADDR_NULL;
+    BOOL skip_first_change_bool = TRUE;
+    cust_char_t cur_char = start_char;
+    BOOL loopback_detected = TRUE;
+    BOOL node_fchar_known = FALSE;
+    int16_t storage_index = 1;
+    cust_char_t node_fchar = 0;
+    
+    char_array[0] = ' '; char_array[1] = ' ';
+    
+    /* Go backwards through the entries, starting with the current one */
+    for (uint16_t i = 0; i < nb_entries; i++)
+    {
+        uint16_t position = (start_position + nb_entries - i) % nb_entries;
+        
+        /* First letter changes when the entry we just went through starts a new letter */
+        if ((i == 0) || (nodemgmt_is_service_index_entry_new_letter(credential_type_id, (position + 1) % nb_entries) != FALSE))
+        {
+            node_fchar_known = FALSE;
+        }
+        
+        uint16_t current_node_addr = nodemgmt_get_service_index_entry_for_cur_category(credential_type_id, position);
+        
+        /* Part of current category? */
+        if (current_node_addr != NODE_ADDR_NULL)
+        {
+            /* Only read the first letter once per letter */
+            if (node_fchar_known == FALSE)
+            {
+                node_fchar = nodemgmt_get_service_index_entry_first_char(credential_type_id, position);
+                node_fchar_known = TRUE;
+            }
+            
+            /* Check if the fchar changed */
+            if (node_fchar != cur_char)
+            {
+                if (skip_first_change_bool == FALSE)
+                {
+                    char_array[storage_index--] = cur_char;
+                    
+                    /* First next letter, store address */
+                    if (storage_index == 0)
+                    {
+                        return_value = last_seen_parent_node_that_fits_category;
+                    }
+                    
+                    /* Did we fill the array? */
+                    if (storage_index == -1)
+                    {
+                        loopback_detected = FALSE;
+                        break;
+                    }
+                }
+                else
+                {
+                    skip_first_change_bool = FALSE;
+                }
+                
+                cur_char = node_fchar;
+            }
+            
+            /* Store parent node address */
+            last_seen_parent_node_that_fits_category = current_node_addr;
+        }
+    }
+    
+    /* We looped back, but didn't have the occasion to store the credential */
+    if ((loopback_detected != FALSE) && (cur_char != start_char))
+    {
+        char_array[storage_index--] = cur_char;
+        
+        /* First next letter, store address */
+        if (storage_index == 0)
+        {
+            return_value = last_seen_parent_node_that_fits_category;
+        }
+    }
+    
+    return return_value;
+}
+
+/*! \fn     logic_database_get_next_2_fletters_services_from_index(uint16_t start_position, uint16_t nb_entries, cust_char_t cur_char, cust_char_t* char_array, uint16_t credential_type_id)
+*   \brief  Get the next 2 services with different first letters, using the service index
+*   \param  start_position      Service index position at which we should start looking
+*   \param  nb_entries          Number of service index entries for that credential type
+*   \param  cur_char            The current first char
+*   \param  char_array          An array for 2 chars
+*   \param  credential_type_id  Credential type ID
+*   \return Address of the next node having a different first letter
+*   \note   Same logic as logic_database_get_next_2_fletters_services, only reading a first letter when it changes
+*/
+static uint16_t logic_database_get_next_2_fletters_services_from_index(uint16_t start_position, uint16_t nb_entries, cust_char_t cur_char, cust_char_t* char_array, uint16_t credential_type_id)
+{
+    uint16_t return_value = NODE_ADDR_NULL;
+    uint16_t storage_index = 0;
+    cust_char_t node_fchar = 0;
+    
+    char_array[0] = ' '; char_array[1] = ' ';
+    
+    /* Go forward through the entries, starting with the current one */
+    for (uint16_t i = 0; i < nb_entries; i++)
+    {
+        uint16_t position = (start_position + i) % nb_entries;
+        
+        /* Only read the first letter when it changes */
+        if ((i == 0) || (nodemgmt_is_service_index_entry_new_letter(credential_type_id, position) != FALSE))
+        {
+            node_fchar = nodemgmt_get_service_index_entry_first_char(credential_type_id, position);
+        }
+        
+        /* Check if the fchar changed, then if the parent is part of current category */
+        if (node_fchar != cur_char)
+        {
+            uint16_t current_node_addr = nodemgmt_get_service_index_entry_for_cur_category(credential_type_id, position);
+            
+            if (current_node_addr != NODE_ADDR_NULL)
+            {
+                /* Store node */
+                char_array[storage_index++] = node_fchar;
+                cur_char = node_fchar;
+                
+                /* First next letter, store address */
+                if (storage_index == 1)
+                {
+                    return_value = current_node_addr;
+                }
+                
+                /* Did we fill the array? */
+                if (storage_index == 2)
+                {
+                    break;
+                }
+            }
+        }
+    }
+    
+    return return_value;
+}
+
 /*! \fn     logic_database_get_prev_2_fletters_services(uint16_t start_address, cust_char_t start_char, cust_char_t* char_array, uint16_t credential_type_id)
 *   \brief  Get the previous 2 services with different first letters
 *   \param  start_address       Address at which we should start looking
@@ -47,6 +199,14 @@ uint16_t logic_database_get_prev_2_fletters_services(uint16_t start_address, cus
     int16_t storage_index = 1;
     parent_node_t temp_pnode;
     
+    /* Service index available: use it instead of reading the parent nodes */
+    uint16_t nb_index_entries = nodemgmt_get_service_index_nb_entries(credential_type_id);
+    uint16_t start_index_position = nodemgmt_get_service_index_position(credential_type_id, start_address);
+    if ((nb_index_entries != 0) && (start_index_position != NODEMGMT_SERVICE_INDEX_POS_INVALID))
+    {
+        return logic_database_get_prev_2_fletters_services_from_index(start_index_position, nb_index_entries, start_char, char_array, credential_type_id);
+    }
+    
     /* To start with the loop below */
     temp_pnode.cred_parent.prevParentAddress = start_address;
     char_array[0] = ' '; char_array[1] = ' ';
@@ -141,6 +301,14 @@ uint16_t logic_database_get_next_2_fletters_services(uint16_t start_address, cus
     uint16_t storage_index = 0;
     parent_node_t temp_pnode;
     
+    /* Service index available: use it instead of reading the parent nodes */
+    uint16_t nb_index_entries = nodemgmt_get_service_index_nb_entries(credential_type_id);
+    uint16_t start_index_position = nodemgmt_get_service_index_position(credential_type_id, start_address);
+    if ((nb_index_entries != 0) && (start_index_position != NODEMGMT_SERVICE_INDEX_POS_INVALID))
+    {
+        return logic_database_get_next_2_fletters_services_from_index(start_index_position, nb_index_entries, cur_char, char_array, credential_type_id);
+    }
+    
     /* To start with the loop below */
     temp_pnode.cred_parent.nextParentAddress = start_address;
     char_array[0] = ' '; char_array[1] = ' ';
@@ -257,6 +425,57 @@ uint16_t logic_database_search_for_next_data_parent_after_addr(uint16_t node_add
     return NODE_ADDR_NULL;
 }
 
+/*! \fn     logic_database_is_service_match(cust_char_t* name, parent_node_t* pnode, BOOL mult_domain_possible, uint16_t name_length_for_mult_domain_match, int16_t* compare_result)
+*   \brief  Check if a given service name matches a given parent node
+*   \param  name                                Name of the service / website
+*   \param  pnode                               Parent node, read with data_clean set
+*   \param  mult_domain_possible                If the multiple domain match can be used
+*   \param  name_length_for_mult_domain_match   Service name length, for multiple domain match
+*   \param  compare_result                      Where to store the service name comparison result
+*   \return TRUE if the parent node matches
+*/
+static BOOL logic_database_is_service_match(cust_char_t* name, parent_node_t* pnode, BOOL mult_domain_possible, uint16_t name_length_for_mult_domain_match, int16_t* compare_result)
+{
+    *compare_result = utils_custchar_strncmp(name, pnode->cred_parent.service, ARRAY_SIZE(pnode->cred_parent.service));
+    
+    /* Hey future Mathieu! Data parent category filter could be setup here... but then each file name must be unique across all categories... */
+    
+    /* Perfect match */
+    if ((*compare_result == 0) && ((pnode->cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) == 0))
+    {
+        return TRUE;
+    }
+    
+    /* Multi-domain feature: possible, enabled, match on first part? Service is 0 terminated by previous read parent node call */
+    if ((mult_domain_possible != FALSE) && ((pnode->cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) != 0) && (utils_custchar_strncmp(name, pnode->cred_parent.service_and_mult_dom.service, utils_strlen(pnode->cred_parent.service_and_mult_dom.service)) == 0))
+    {
+        uint16_t candidate_domain_length = utils_strlen(pnode->cred_parent.service_and_mult_dom.service);
+        uint16_t start_index = 0;
+        
+        /* Let's go through the listed possible domains separated by ',' and try to find a match */
+        for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(shorten_service_with_mult_dom_t, mult_domain); i++)
+        {
+            /* We got a separator */
+            if ((pnode->cred_parent.service_and_mult_dom.mult_domain[i] == ',') || (pnode->cred_parent.service_and_mult_dom.mult_domain[i] == 0))
+            {
+                /* Check for same domain length then same domain */
+                if (((i-start_index) != 0) &&
+                    ((name_length_for_mult_domain_match-candidate_domain_length) == (i - start_index)) &&
+                    (utils_custchar_strncmp(&name[candidate_domain_length], &pnode->cred_parent.service_and_mult_dom.mult_domain[start_index], name_length_for_mult_domain_match-candidate_domain_length) == 0))
+                {
+                    return TRUE;
+                }
+                else
+                {
+                    start_index = i+1;
+                }
+            }
+        }
+    }
+    
+    return FALSE;
+}
+
 /*! \fn     logic_database_search_service(cust_char_t* name, service_compare_mode_te compare_type, BOOL cred_type, uint16_t category_id)
 *   \brief  Find a given service name
 *   \param  name                    Name of the service / website
@@ -265,6 +484,7 @@ uint16_t logic_database_search_for_next_data_parent_after_addr(uint16_t node_add
 *   \param  category_id             Credential/Data category ID
 *   \return Address of the found node, NODE_ADDR_NULL otherwise
 *   \note   Full 8Mb database search has been timed at 581ms
+*   \note   Match searches use the nodemgmt service index when valid: only parents with matching service hash (and multiple domain parents) are read
 */
 uint16_t logic_database_search_service(cust_char_t* name, service_compare_mode_te compare_type, BOOL cred_type, uint16_t category_id)
 {
@@ -292,6 +512,30 @@ uint16_t logic_database_search_service(cust_char_t* name, service_compare_mode_t
         }
     }
     
+    /* Service index available: only check candidates, in alphabetical order */
+    if ((compare_type == COMPARE_MODE_MATCH) && (nodemgmt_is_service_index_valid() != FALSE))
+    {
+        uint16_t service_hash = nodemgmt_get_service_hash(name, MEMBER_ARRAY_SIZE(parent_cred_node_t, service));
+        uint16_t index_iterator = 0;
+        
+        while ((next_node_addr = nodemgmt_get_next_service_index_candidate((cred_type == FALSE)? TRUE:FALSE, category_id, service_hash, mult_domain_possible, &index_iterator)) != NODE_ADDR_NULL)
+        {
+            /* Read parent node */
+            if (nodemgmt_read_parent_node_permissive(next_node_addr, &temp_pnode, TRUE) != RETURN_OK)
+            {
+                return NODE_ADDR_NULL;
+            }
+            
+            /* Check for match */
+            if (logic_database_is_service_match(name, &temp_pnode, mult_domain_possible, name_length_for_mult_domain_match, &compare_result) != FALSE)
+            {
+                return next_node_addr;
+            }
+        }
+        
+        return NODE_ADDR_NULL;
+    }
+    
     /* Get start node */
     if (cred_type != FALSE)
     {
@@ -328,44 +572,12 @@ uint16_t logic_database_search_service(cust_char_t* name, service_compare_mode_t
             /* Compare its service name with the name that was provided */
             if (compare_type == COMPARE_MODE_MATCH)
             {
-                compare_result = utils_custchar_strncmp(name, temp_pnode.cred_parent.service, ARRAY_SIZE(temp_pnode.cred_parent.service));
-                
-                /* Hey future Mathieu! Data parent category filter could be setup here... but then each file name must be unique across all categories... */
-                
-                /* Perfect match */
-                if ((compare_result == 0) && ((temp_pnode.cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) == 0))
+                if (logic_database_is_service_match(name, &temp_pnode, mult_domain_possible, name_length_for_mult_domain_match, &compare_result) != FALSE)
                 {
                     /* Result found */
                     return next_node_addr;
                 }
                 
-                /* Multi-domain feature: possible, enabled, match on first part? Service is 0 terminated by previous read parent node call */
-                if ((mult_domain_possible != FALSE) && ((temp_pnode.cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) != 0) && (utils_custchar_strncmp(name, temp_pnode.cred_parent.service_and_mult_dom.service, utils_strlen(temp_pnode.cred_parent.service_and_mult_dom.service)) == 0))
-                {
-                    uint16_t candidate_domain_length = utils_strlen(temp_pnode.cred_parent.service_and_mult_dom.service);
-                    uint16_t start_index = 0;
-                        
-                    /* Let's go through the listed possible domains separated by ',' and try to find a match */
-                    for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(shorten_service_with_mult_dom_t, mult_domain); i++)
-                    {
-                        /* We got a separator */
-                        if ((temp_pnode.cred_parent.service_and_mult_dom.mult_domain[i] == ',') || (temp_pnode.cred_parent.service_and_mult_dom.mult_domain[i] == 0))
-                        {
-                            /* Check for same domain length then same domain */
-                            if (((i-start_index) != 0) &&
-                                ((name_length_for_mult_domain_match-candidate_domain_length) == (i - start_index)) &&
-                                (utils_custchar_strncmp(&name[candidate_domain_length], &temp_pnode.cred_parent.service_and_mult_dom.mult_domain[start_index], name_length_for_mult_domain_match-candidate_domain_length) == 0))
-                            {
-                                return next_node_addr;
-                            }
-                            else
-                            {
-                                start_index = i+1;
-                            }
-                        }
-                    }
-                }
-                
                 /* Nodes are alphabetically sorted, escape if we went over */
                 if (compare_result < 0)
                 {
@@ -728,15 +940,16 @@ uint16_t logic_database_get_number_of_creds_for_service(uint16_t parent_addr, ui
     return return_val;    
 }
 
-/*! \fn     logic_database_add_service(cust_char_t* service, BOOL cred_type, uint16_t data_category_id)
+/*! \fn     logic_database_add_service(cust_char_t* service, service_type_te cred_type, uint16_t data_category_id, uint16_t search_start_address)
 *   \brief  Add a new service to our database
 *   \param  service                 Name of the service / website
 *   \param  cred_type               Service type (see enum)
 *   \param  data_category_id        If cred_type is set to FALSE, the data category ID
+*   \param  search_start_address    Parent address from which to look for the insertion point (eg: previously added service when adding sorted services), or NODE_ADDR_NULL
 *   \return Address of the found node, NODE_ADDR_NULL if fail
 *   \note   Please call logic_database_search_service before calling this
 */
-uint16_t logic_database_add_service(cust_char_t* service, service_type_te cred_type, uint16_t data_category_id)
+uint16_t logic_database_add_service(cust_char_t* service, service_type_te cred_type, uint16_t data_category_id, uint16_t search_start_address)
 {
     uint16_t storage_addr = NODE_ADDR_NULL;
     parent_node_t temp_pnode;
@@ -748,7 +961,7 @@ uint16_t logic_database_add_service(cust_char_t* service, service_type_te cred_t
     utils_strncpy(temp_pnode.cred_parent.service, service, sizeof(temp_pnode.cred_parent.service)/sizeof(cust_char_t));
     
     /* Create parent node, function handles flag setting etc */
-    if (nodemgmt_create_parent_node(&temp_pnode, cred_type, &storage_addr, data_category_id) == RETURN_OK)
+    if (nodemgmt_create_parent_node(&temp_pnode, cred_type, &storage_addr, data_category_id, search_start_address) == RETURN_OK)
     {
         return storage_addr;
     }
@@ -194,11 +194,12 @@ void logic_encryption_delete_context(void)
 /*! \fn     logic_encryption_pre_ctr_tasks(void)
 *   \brief  CTR pre encryption tasks
 *   \param  ctr_inc     By how much we are planning to increment ctr value
+*   \note   Can be called with the total increment of several upcoming encryptions so the profile CTR is written once
 */
 void logic_encryption_pre_ctr_tasks(uint16_t ctr_inc)
 {
     uint8_t temp_buffer[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
-    uint16_t carry = CTR_FLASH_MIN_INCR;
+    uint16_t carry = (ctr_inc > CTR_FLASH_MIN_INCR)? ctr_inc : CTR_FLASH_MIN_INCR;
     int16_t i;
     
     // Read CTR stored in flash
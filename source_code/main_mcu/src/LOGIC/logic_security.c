@@ -23,6 +23,7 @@
 #include "logic_bluetooth.h"
 #include "logic_security.h"
 #include "logic_aux_mcu.h"
+#include "nodemgmt.h"
 /* Inserted card unlocked */
 volatile BOOL logic_security_smartcard_inserted_unlocked = FALSE;
 /* Memory management mode */
@@ -65,6 +66,8 @@ BOOL logic_security_is_smc_inserted_unlocked(void)
 */
 void logic_security_set_management_mode(BOOL from_usb)
 {
+    /* Database may be changed externally: service index is rebuilt when leaving MMM */
+    nodemgmt_invalidate_service_index();
     logic_security_management_mode = TRUE;
     logic_security_management_mode_from_usb = from_usb;
 }
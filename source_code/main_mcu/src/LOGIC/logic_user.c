@@ -647,7 +647,7 @@ fido2_return_code_te logic_user_store_webauthn_credential(cust_char_t* rp_id, ui
     /* If needed, add service */
     if (parent_address == NODE_ADDR_NULL)
     {
-        parent_address = logic_database_add_service(rp_id, SERVICE_CRED_TYPE, NODEMGMT_WEBAUTHN_CRED_TYPE_ID);
+        parent_address = logic_database_add_service(rp_id, SERVICE_CRED_TYPE, NODEMGMT_WEBAUTHN_CRED_TYPE_ID, NODE_ADDR_NULL);
         
         /* Check for operation success */
         if (parent_address == NODE_ADDR_NULL)
@@ -1046,7 +1046,7 @@ RET_TYPE logic_user_add_data_service(cust_char_t* service, BOOL is_message_from_
     }
     
     /* Add data service */
-    logic_user_data_service_addr = logic_database_add_service(service, SERVICE_DATA_TYPE, data_type);
+    logic_user_data_service_addr = logic_database_add_service(service, SERVICE_DATA_TYPE, data_type, NODE_ADDR_NULL);
     
     /* Check for operation success */
     if (logic_user_data_service_addr == NODE_ADDR_NULL)
@@ -1141,17 +1141,18 @@ void logic_user_change_node_password(uint16_t node_address, cust_char_t* passwor
     logic_database_update_credential(node_address, 0, 0, (uint8_t*)encrypted_password, temp_cred_ctr_val);
 }
 
-/*! \fn     logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password)
+/*! \fn     logic_user_store_credential_with_service_hint(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password, uint16_t* service_hint_address)
 *   \brief  Store new credential
-*   \param  service     Pointer to service string
-*   \param  login       Pointer to login string
-*   \param  desc        Pointer to description string, or 0 if not specified
-*   \param  third       Pointer to arbitrary third field, or 0 if not specified
-*   \param  password    Pointer to password string, or 0 if not specified
+*   \param  service                 Pointer to service string
+*   \param  login                   Pointer to login string
+*   \param  desc                    Pointer to description string, or 0 if not specified
+*   \param  third                   Pointer to arbitrary third field, or 0 if not specified
+*   \param  password                Pointer to password string, or 0 if not specified
+*   \param  service_hint_address    Pointer to the address of a service coming before this one (or NODE_ADDR_NULL), updated with this credential parent address
 *   \note   As we are using the RX buffer here, we are exiting this function the moment we receive a new RX message (think power switches) but also don't try listen to RX messages
 *   \return success or not
 */
-RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password)
+static RET_TYPE logic_user_store_credential_with_service_hint(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password, uint16_t* service_hint_address)
 {
     cust_char_t encrypted_password[MEMBER_SIZE(child_cred_node_t, password)/sizeof(cust_char_t)];
     uint8_t temp_cred_ctr_val[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
@@ -1202,7 +1203,7 @@ RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, c
     /* If needed, add service */
     if (parent_address == NODE_ADDR_NULL)
     {
-        parent_address = logic_database_add_service(service, SERVICE_CRED_TYPE, NODEMGMT_STANDARD_CRED_TYPE_ID);
+        parent_address = logic_database_add_service(service, SERVICE_CRED_TYPE, NODEMGMT_STANDARD_CRED_TYPE_ID, *service_hint_address);
         
         /* Check for operation success */
         if (parent_address == NODE_ADDR_NULL)
@@ -1211,6 +1212,9 @@ RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, c
         }
     }
     
+    /* Next service search can start from here */
+    *service_hint_address = parent_address;
+    
     /* Fill RNG array with random numbers */
     rng_fill_array((uint8_t*)encrypted_password, sizeof(encrypted_password));
     
@@ -1255,6 +1259,63 @@ RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, c
     }
 }
 
+/*! \fn     logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password)
+*   \brief  Store new credential
+*   \param  service     Pointer to service string
+*   \param  login       Pointer to login string
+*   \param  desc        Pointer to description string, or 0 if not specified
+*   \param  third       Pointer to arbitrary third field, or 0 if not specified
+*   \param  password    Pointer to password string, or 0 if not specified
+*   \note   As we are using the RX buffer here, we are exiting this function the moment we receive a new RX message (think power switches) but also don't try listen to RX messages
+*   \return success or not
+*/
+RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password)
+{
+    uint16_t service_hint_address = NODE_ADDR_NULL;
+    return logic_user_store_credential_with_service_hint(service, login, desc, third, password, &service_hint_address);
+}
+
+/*! \fn     logic_user_prepare_credentials_import(uint16_t nb_credentials)
+*   \brief  Prepare the import of a batch of credentials
+*   \param  nb_credentials  Number of credentials that are going to be imported
+*   \return success or not: imports are only allowed in management mode when the user chose to not be prompted for credential storage
+*   \note   Makes the service index usable again after external database changes and reserves the CTR values for all the credentials in one go
+*/
+RET_TYPE logic_user_prepare_credentials_import(uint16_t nb_credentials)
+{
+    /* Smartcard present and unlocked, in MMM, no prompts wanted */
+    if ((logic_security_is_smc_inserted_unlocked() == FALSE) || (logic_security_is_management_mode_set() == FALSE) || ((logic_user_get_user_security_flags() & USER_SEC_FLG_CRED_SAVE_PROMPT_MMM) != 0))
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Database may have been changed by the computer: rescan last parents & rebuild service index */
+    if (nodemgmt_is_service_index_valid() == FALSE)
+    {
+        nodemgmt_trigger_db_ext_changed_actions();
+    }
+    
+    /* Single profile CTR update for all the password encryptions */
+    logic_encryption_pre_ctr_tasks(nb_credentials * ((MEMBER_SIZE(child_cred_node_t, password)*8 + AES256_CTR_LENGTH - 1)/AES256_CTR_LENGTH));
+    return RETURN_OK;
+}
+
+/*! \fn     logic_user_import_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password, uint16_t* service_hint_address)
+*   \brief  Import a credential, part of a batch sorted by service name
+*   \param  service                 Pointer to service string
+*   \param  login                   Pointer to login string
+*   \param  desc                    Pointer to description string, or 0 if not specified
+*   \param  third                   Pointer to arbitrary third field, or 0 if not specified
+*   \param  password                Pointer to password string, or 0 if not specified
+*   \param  service_hint_address    Pointer to the previously imported credential parent address, NODE_ADDR_NULL for the first one
+*   \return success or not
+*   \note   logic_user_prepare_credentials_import must be called before. New services are inserted by continuing the parent list walk from the previously imported service
+*/
+RET_TYPE logic_user_import_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password, uint16_t* service_hint_address)
+{
+    return logic_user_store_credential_with_service_hint(service, login, desc, third, password, service_hint_address);
+}
+
 /*! \fn     logic_user_sanitize_TOTP(TOTPcredentials_t const *TOTPcreds)
 *   \brief  Sanitize input TOTP credentials
 *   \param  TOTPcreds      Pointer to the TOTP credentials
@@ -1353,7 +1414,7 @@ RET_TYPE logic_user_store_TOTP_credential(cust_char_t* service, cust_char_t* log
     /* If needed, add service */
     if (parent_address == NODE_ADDR_NULL)
     {
-        parent_address = logic_database_add_service(service, SERVICE_CRED_TYPE, NODEMGMT_STANDARD_CRED_TYPE_ID);
+        parent_address = logic_database_add_service(service, SERVICE_CRED_TYPE, NODEMGMT_STANDARD_CRED_TYPE_ID, NODE_ADDR_NULL);
 
         /* Check for operation success */
         if (parent_address == NODE_ADDR_NULL)
@@ -38,6 +38,7 @@ fido2_return_code_te logic_user_get_webauthn_credential_key_for_rp(cust_char_t*
 RET_TYPE logic_user_ask_for_credentials_keyb_output(uint16_t parent_address, uint16_t child_address, BOOL skip_login_prompt_and_int_choice, BOOL* usb_selected, lock_feature_te keys_to_send_before_login, BOOL skip_login_prompt, BOOL no_password_prompt);
 fido2_return_code_te logic_user_store_webauthn_credential(cust_char_t* rp_id, uint8_t* user_handle, uint8_t user_handle_len, cust_char_t* user_name, cust_char_t* display_name, uint8_t* private_key, uint8_t* credential_id, uint8_t keyType);
 ret_type_te logic_user_create_new_user_for_existing_card(cpz_lut_entry_t* cpz_entry, uint16_t sec_preferences, uint16_t language_id, uint16_t usb_layout_id, uint16_t ble_layout_id, uint8_t* new_user_id);
+RET_TYPE logic_user_import_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password, uint16_t* service_hint_address);
 RET_TYPE logic_user_get_data_from_service(cust_char_t* service, uint8_t* buffer, uint16_t* nb_bytes_written, BOOL is_message_from_usb, nodemgmt_data_category_te data_type);
 RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password);
 RET_TYPE logic_user_add_data_to_current_service(hid_message_store_data_into_file_t* store_data_request, BOOL is_message_from_usb);
@@ -52,6 +53,7 @@ RET_TYPE logic_user_check_data_service(cust_char_t* service, nodemgmt_data_categ
 RET_TYPE logic_user_is_bluetooth_enabled_for_inserted_card(uint16_t* user_language_id);
 void logic_user_change_node_password(uint16_t node_address, cust_char_t* password);
 void logic_user_inform_computer_locked_state(BOOL usb_interface, BOOL locked);
+RET_TYPE logic_user_prepare_credentials_import(uint16_t nb_credentials);
 void logic_user_set_preferred_starting_service(uint16_t service_addr);
 void logic_user_set_layout_id(uint16_t layout_id, BOOL usb_layout);
 BOOL logic_user_is_category_to_be_switched(uint16_t* category_id);
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <stddef.h>
 #include "comms_hid_msgs_debug.h"
+#include "logic_encryption.h"
 #include "logic_device.h"
 #include "driver_timer.h"
 #include "nodemgmt.h"
@@ -118,6 +119,842 @@ static inline uint16_t userIdFromFlags(uint16_t flags)
     return ((flags >> NODEMGMT_USERID_BITSHIFT) & NODEMGMT_USERID_MASK_FINAL);
 }
 
+/*! \fn     nodemgmt_get_node_slot_index(uint16_t address)
+*   \brief  Gets the index of a node slot in the node usage bitmap
+*   \param  address     A valid node address (sector 0 excluded)
+*   \return The slot index
+*/
+static inline uint16_t nodemgmt_get_node_slot_index(uint16_t address)
+{
+    return ((nodemgmt_page_from_address(address) - PAGE_PER_SECTOR) * NODEMGMT_NB_NODES_PER_PAGE) + nodemgmt_node_from_address(address);
+}
+
+/*! \fn     nodemgmt_get_address_from_node_slot_index(uint16_t slot_index)
+*   \brief  Gets the node address for a given index in the node usage bitmap
+*   \param  slot_index  The slot index
+*   \return The node address
+*/
+static inline uint16_t nodemgmt_get_address_from_node_slot_index(uint16_t slot_index)
+{
+    return constructAddress((slot_index / NODEMGMT_NB_NODES_PER_PAGE) + PAGE_PER_SECTOR, (uint8_t)(slot_index % NODEMGMT_NB_NODES_PER_PAGE));
+}
+
+/*! \fn     nodemgmt_update_node_usage_bitmap(uint16_t address, uint16_t flags)
+*   \brief  Update the node usage bitmap for a given node slot
+*   \param  address     A valid node address (sector 0 excluded)
+*   \param  flags       The flags (or fake flags) written at the beginning of that slot
+*/
+static inline void nodemgmt_update_node_usage_bitmap(uint16_t address, uint16_t flags)
+{
+    uint16_t slot_index = nodemgmt_get_node_slot_index(address);
+
+    if (validBitFromFlags(flags) == NODEMGMT_VBIT_VALID)
+    {
+        nodemgmt_current_handle.nodeUsageBitmap[slot_index >> 5] |= (1UL << (slot_index & 0x1F));
+    }
+    else
+    {
+        nodemgmt_current_handle.nodeUsageBitmap[slot_index >> 5] &= ~(1UL << (slot_index & 0x1F));
+    }
+}
+
+/*! \fn     nodemgmt_get_service_index_list_start(uint16_t list_id)
+*   \brief  Get the index of the first service index entry for a given parent list
+*   \param  list_id     Parent list ID: credential type ID, or data type ID + number of credential types
+*   \return The entry index
+*/
+static inline uint16_t nodemgmt_get_service_index_list_start(uint16_t list_id)
+{
+    uint16_t start_index = 0;
+    
+    for (uint16_t i = 0; i < list_id; i++)
+    {
+        start_index += nodemgmt_current_handle.serviceIndexCounts[i];
+    }
+    return start_index;
+}
+
+/*! \fn     nodemgmt_read_parent_service_first_char(uint16_t address)
+*   \brief  Read the service first letter of a given parent node
+*   \param  address     Parent node address
+*   \return The first letter
+*/
+static cust_char_t nodemgmt_read_parent_service_first_char(uint16_t address)
+{
+    cust_char_t first_char;
+    
+    nodemgmt_check_address_validity_and_lock(address);
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address) + offsetof(parent_cred_node_t, service), sizeof(first_char), (void*)&first_char);
+    return first_char;
+}
+
+/*! \fn     nodemgmt_update_service_index_new_letter_flag(uint16_t list_id, uint16_t entry_index)
+*   \brief  Set or clear the new letter flag of a given service index entry, by comparing its first letter with the previous entry one
+*   \param  list_id     Parent list ID: credential type ID, or data type ID + number of credential types
+*   \param  entry_index Entry index, wrapped over to the list first entry if it is past its last one
+*   \note   The list first entry is compared with its last one, as the lists are browsed in a loop
+*/
+static void nodemgmt_update_service_index_new_letter_flag(uint16_t list_id, uint16_t entry_index)
+{
+    uint16_t start_index = nodemgmt_get_service_index_list_start(list_id);
+    uint16_t end_index = start_index + nodemgmt_current_handle.serviceIndexCounts[list_id];
+    uint16_t prev_index;
+    
+    /* Empty list */
+    if (start_index == end_index)
+    {
+        return;
+    }
+    
+    /* Wrapover */
+    if (entry_index >= end_index)
+    {
+        entry_index = start_index;
+    }
+    prev_index = (entry_index == start_index)? end_index-1 : entry_index-1;
+    
+    if (nodemgmt_read_parent_service_first_char(nodemgmt_current_handle.serviceIndex[entry_index].address) != nodemgmt_read_parent_service_first_char(nodemgmt_current_handle.serviceIndex[prev_index].address))
+    {
+        nodemgmt_current_handle.serviceIndex[entry_index].hash |= NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG;
+    }
+    else
+    {
+        nodemgmt_current_handle.serviceIndex[entry_index].hash &= ~NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG;
+    }
+}
+
+/*! \fn     nodemgmt_compute_service_index_hash(parent_node_t* parent_node)
+*   \brief  Compute the service index hash for a given parent node
+*   \param  parent_node The parent node
+*   \return The service index hash, with NODEMGMT_SERVICE_INDEX_MULT_DOMAIN_FLAG set for multiple domain parents
+*   \note   String is cleaned the same way nodemgmt_read_parent_node_permissive does it
+*/
+static uint16_t nodemgmt_compute_service_index_hash(parent_node_t* parent_node)
+{
+    if ((parent_node->cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) != 0)
+    {
+        return nodemgmt_get_service_hash(parent_node->cred_parent.service_and_mult_dom.service, MEMBER_ARRAY_SIZE(shorten_service_with_mult_dom_t, service)-1) | NODEMGMT_SERVICE_INDEX_MULT_DOMAIN_FLAG;
+    }
+    else
+    {
+        return nodemgmt_get_service_hash(parent_node->cred_parent.service, MEMBER_ARRAY_SIZE(parent_cred_node_t, service)-1);
+    }
+}
+
+/*! \fn     nodemgmt_add_to_service_index(uint16_t list_id, uint16_t address, parent_node_t* parent_node)
+*   \brief  Add a newly inserted parent node to the service index
+*   \param  list_id     Parent list ID: credential type ID, or data type ID + number of credential types
+*   \param  address     Parent node address
+*   \param  parent_node The parent node, as written in flash (next parent address is used to locate the entry)
+*   \note   Service index is invalidated if it is full or if the next parent can't be found
+*/
+static void nodemgmt_add_to_service_index(uint16_t list_id, uint16_t address, parent_node_t* parent_node)
+{
+    uint16_t start_index = nodemgmt_get_service_index_list_start(list_id);
+    uint16_t end_index = start_index + nodemgmt_current_handle.serviceIndexCounts[list_id];
+    uint16_t nb_entries = nodemgmt_get_service_index_list_start(MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts));
+    uint16_t insert_index = end_index;
+    
+    /* Index not valid or full */
+    if ((nodemgmt_current_handle.serviceIndexValid == FALSE) || (nb_entries >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndex)))
+    {
+        nodemgmt_current_handle.serviceIndexValid = FALSE;
+        return;
+    }
+    
+    /* Node was inserted before another one: find it */
+    if (parent_node->cred_parent.nextParentAddress != NODE_ADDR_NULL)
+    {
+        for (insert_index = start_index; insert_index < end_index; insert_index++)
+        {
+            if (nodemgmt_current_handle.serviceIndex[insert_index].address == parent_node->cred_parent.nextParentAddress)
+            {
+                break;
+            }
+        }
+        
+        /* Not found: our index isn't in sync with the database */
+        if (insert_index == end_index)
+        {
+            nodemgmt_current_handle.serviceIndexValid = FALSE;
+            return;
+        }
+    }
+    
+    /* Make space and store entry, children categories are computed when needed */
+    memmove(&nodemgmt_current_handle.serviceIndex[insert_index+1], &nodemgmt_current_handle.serviceIndex[insert_index], (nb_entries-insert_index)*sizeof(nodemgmt_current_handle.serviceIndex[0]));
+    memmove(&nodemgmt_current_handle.serviceIndexCategories[insert_index+1], &nodemgmt_current_handle.serviceIndexCategories[insert_index], (nb_entries-insert_index)*sizeof(nodemgmt_current_handle.serviceIndexCategories[0]));
+    nodemgmt_current_handle.serviceIndex[insert_index].address = address;
+    nodemgmt_current_handle.serviceIndex[insert_index].hash = nodemgmt_compute_service_index_hash(parent_node);
+    nodemgmt_current_handle.serviceIndexCategories[insert_index] = 0;
+    nodemgmt_current_handle.serviceIndexCounts[list_id]++;
+    
+    /* Update the new letter flags of the new entry and the one after it */
+    nodemgmt_update_service_index_new_letter_flag(list_id, insert_index);
+    nodemgmt_update_service_index_new_letter_flag(list_id, insert_index+1);
+}
+
+/*! \fn     nodemgmt_remove_from_service_index(uint16_t address)
+*   \brief  Remove a given address from the service index, if present
+*   \param  address     Node address
+*/
+static void nodemgmt_remove_from_service_index(uint16_t address)
+{
+    uint16_t entry_index = 0;
+    
+    if (nodemgmt_current_handle.serviceIndexValid == FALSE)
+    {
+        return;
+    }
+    
+    /* Go through each list */
+    for (uint16_t list_id = 0; list_id < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts); list_id++)
+    {
+        for (uint16_t i = 0; i < nodemgmt_current_handle.serviceIndexCounts[list_id]; i++)
+        {
+            if (nodemgmt_current_handle.serviceIndex[entry_index].address == address)
+            {
+                uint16_t nb_entries = nodemgmt_get_service_index_list_start(MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts));
+                memmove(&nodemgmt_current_handle.serviceIndex[entry_index], &nodemgmt_current_handle.serviceIndex[entry_index+1], (nb_entries-entry_index-1)*sizeof(nodemgmt_current_handle.serviceIndex[0]));
+                memmove(&nodemgmt_current_handle.serviceIndexCategories[entry_index], &nodemgmt_current_handle.serviceIndexCategories[entry_index+1], (nb_entries-entry_index-1)*sizeof(nodemgmt_current_handle.serviceIndexCategories[0]));
+                nodemgmt_current_handle.serviceIndexCounts[list_id]--;
+                
+                /* Update the new letter flag of the entry that took its place */
+                nodemgmt_update_service_index_new_letter_flag(list_id, entry_index);
+                return;
+            }
+            entry_index++;
+        }
+    }
+}
+
+/*! \fn     nodemgmt_get_service_index_entry(uint16_t list_id, uint16_t address)
+*   \brief  Find the service index entry for a given parent address
+*   \param  list_id     Parent list ID: credential type ID, or data type ID + number of credential types
+*   \param  address     Parent node address
+*   \return Pointer to the entry, or 0 if the index isn't valid or if the address wasn't found
+*/
+static nodemgmt_service_index_entry_t* nodemgmt_get_service_index_entry(uint16_t list_id, uint16_t address)
+{
+    if ((nodemgmt_current_handle.serviceIndexValid == FALSE) || (list_id >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts)))
+    {
+        return 0;
+    }
+    
+    uint16_t start_index = nodemgmt_get_service_index_list_start(list_id);
+    for (uint16_t i = start_index; i < start_index + nodemgmt_current_handle.serviceIndexCounts[list_id]; i++)
+    {
+        if (nodemgmt_current_handle.serviceIndex[i].address == address)
+        {
+            return &nodemgmt_current_handle.serviceIndex[i];
+        }
+    }
+    
+    return 0;
+}
+
+/*! \fn     nodemgmt_get_service_index_category_bit(uint16_t category_flags)
+*   \brief  Get the serviceIndexCategories bit for given child category flags
+*   \param  category_flags  Category flags: 0 or a single category bit, see nodemgmt_set_current_category_id
+*   \return The bit
+*/
+static inline uint8_t nodemgmt_get_service_index_category_bit(uint16_t category_flags)
+{
+    if (category_flags == 0)
+    {
+        return NODEMGMT_SERVICE_INDEX_CATS_NONE;
+    }
+    
+    for (uint16_t i = 0; i < NODEMGMT_NB_MAX_CATEGORIES-1; i++)
+    {
+        if (category_flags == (1 << i))
+        {
+            return (NODEMGMT_SERVICE_INDEX_CATS_NONE << (i+1));
+        }
+    }
+    
+    return NODEMGMT_SERVICE_INDEX_CATS_OTHER;
+}
+
+/*! \fn     nodemgmt_reset_service_index_categories(void)
+*   \brief  Forget the children categories of all service index entries, for when a child whose parent isn't known is changed
+*/
+static inline void nodemgmt_reset_service_index_categories(void)
+{
+    memset(nodemgmt_current_handle.serviceIndexCategories, 0, sizeof(nodemgmt_current_handle.serviceIndexCategories));
+}
+
+/*! \fn     nodemgmt_get_change_journal_pages(uint16_t* start_page, uint16_t* stop_page)
+*   \brief  Get the flash pages used by the change journal: the user records pages followed by the entries pages
+*   \param  start_page  Where to store the first user records page
+*   \param  stop_page   Where to store the page following the last entries page
+*   \note   The change journal uses the bluetooth bonding information area left unused by NB_MAX_BONDING_INFORMATION
+*   \note   Sector 0 wear: the AT45DB requires each page of a sector to be rewritten within 50k cumulative page erase/program operations in that sector,
+*           and the user profiles & bonding information pages of sector 0 may never be rewritten. The journal adds one page program per flush
+*           (nodemgmt_user_db_changed_actions, full pending buffer, login, end of memory management mode, changed nodes query) and one page erase
+*           plus one user record write every NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE entries (22 with 264B pages). An on-device credential change
+*           writing 3 nodes costs ~1.3 operations (a single change number write per login before), so ~38k on-device changes use the sector budget.
+*           A memory management mode session costs ~0.22 operations per written node.
+*/
+static void nodemgmt_get_change_journal_pages(uint16_t* start_page, uint16_t* stop_page)
+{
+    _Static_assert(NB_MAX_BONDING_INFORMATION % 4 == 0, "Bonding information doesn't end on a page boundary");
+    _Static_assert(NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE*sizeof(nodemgmt_change_journal_entry_t) == BYTES_PER_PAGE, "Change journal entries don't fill a page");
+    _Static_assert(NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE*sizeof(nodemgmt_change_journal_user_record_t) <= BYTES_PER_PAGE, "Change journal user records don't fit in a page");
+    
+    #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
+        _Static_assert((NB_MAX_BONDING_INFORMATION_TH - NB_MAX_BONDING_INFORMATION)/2 >= NODEMGMT_CHANGE_JOURNAL_NB_RECORD_PAGES + 2, "Not enough space for the change journal");
+        *start_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START*2 + NB_MAX_BONDING_INFORMATION/2;
+        *stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP*2;
+    #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
+        _Static_assert((NB_MAX_BONDING_INFORMATION_TH - NB_MAX_BONDING_INFORMATION)/4 >= NODEMGMT_CHANGE_JOURNAL_NB_RECORD_PAGES + 2, "Not enough space for the change journal");
+        *start_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START + NB_MAX_BONDING_INFORMATION/4;
+        *stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP;
+    #else
+        #error "User profile isn't a multiple of page size"
+    #endif
+}
+
+/*! \fn     nodemgmt_get_change_journal_nb_slots(void)
+*   \brief  Get the number of change journal entry slots
+*   \return The number of slots
+*/
+static uint16_t nodemgmt_get_change_journal_nb_slots(void)
+{
+    uint16_t start_page, stop_page;
+    nodemgmt_get_change_journal_pages(&start_page, &stop_page);
+    return (stop_page - start_page - NODEMGMT_CHANGE_JOURNAL_NB_RECORD_PAGES) * NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE;
+}
+
+/*! \fn     nodemgmt_get_change_journal_slot_page(uint16_t slot)
+*   \brief  Get the flash page of a given change journal entry slot
+*   \param  slot        Slot index
+*   \return The page number
+*/
+static uint16_t nodemgmt_get_change_journal_slot_page(uint16_t slot)
+{
+    uint16_t start_page, stop_page;
+    nodemgmt_get_change_journal_pages(&start_page, &stop_page);
+    return start_page + NODEMGMT_CHANGE_JOURNAL_NB_RECORD_PAGES + slot/NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE;
+}
+
+/*! \fn     nodemgmt_read_change_journal_slot(uint16_t slot, nodemgmt_change_journal_entry_t* entry_pt)
+*   \brief  Read a change journal entry slot
+*   \param  slot        Slot index
+*   \param  entry_pt    Where to store the entry
+*/
+static void nodemgmt_read_change_journal_slot(uint16_t slot, nodemgmt_change_journal_entry_t* entry_pt)
+{
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_get_change_journal_slot_page(slot), (slot % NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE)*sizeof(nodemgmt_change_journal_entry_t), sizeof(*entry_pt), (void*)entry_pt);
+}
+
+/*! \fn     nodemgmt_read_change_journal_user_record(uint16_t user_id, nodemgmt_change_journal_user_record_t* record_pt)
+*   \brief  Read the change journal record of a given user
+*   \param  user_id     User ID
+*   \param  record_pt   Where to store the record
+*/
+static void nodemgmt_read_change_journal_user_record(uint16_t user_id, nodemgmt_change_journal_user_record_t* record_pt)
+{
+    uint16_t start_page, stop_page;
+    nodemgmt_get_change_journal_pages(&start_page, &stop_page);
+    dbflash_read_data_from_flash(&dbflash_descriptor, start_page + user_id/NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE, (user_id % NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE)*sizeof(*record_pt), sizeof(*record_pt), (void*)record_pt);
+}
+
+/*! \fn     nodemgmt_write_change_journal_user_record(uint16_t user_id, nodemgmt_change_journal_user_record_t* record_pt)
+*   \brief  Write the change journal record of a given user
+*   \param  user_id     User ID
+*   \param  record_pt   Pointer to the record
+*/
+static void nodemgmt_write_change_journal_user_record(uint16_t user_id, nodemgmt_change_journal_user_record_t* record_pt)
+{
+    uint16_t start_page, stop_page;
+    nodemgmt_get_change_journal_pages(&start_page, &stop_page);
+    dbflash_write_data_to_flash(&dbflash_descriptor, start_page + user_id/NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE, (user_id % NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE)*sizeof(*record_pt), sizeof(*record_pt), (void*)record_pt);
+}
+
+/*! \fn     nodemgmt_evict_change_journal_page(uint16_t first_slot)
+*   \brief  Erase a change journal entries page, after updating the records of the users whose entries are lost
+*   \param  first_slot  First slot of the page
+*   \note   As change numbers only go up, only the last entry of each user in that page needs to be looked at
+*/
+static void nodemgmt_evict_change_journal_page(uint16_t first_slot)
+{
+    uint16_t done_user_ids[NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE];
+    nodemgmt_change_journal_user_record_t user_record;
+    nodemgmt_change_journal_entry_t temp_entry;
+    uint16_t nb_done_users = 0;
+    
+    /* Go through the entries, latest first */
+    for (uint16_t i = first_slot + NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE; i-- > first_slot;)
+    {
+        BOOL user_done = FALSE;
+        
+        nodemgmt_read_change_journal_slot(i, &temp_entry);
+        if (temp_entry.user_id >= NB_MAX_USERS)
+        {
+            continue;
+        }
+        for (uint16_t j = 0; j < nb_done_users; j++)
+        {
+            if (done_user_ids[j] == temp_entry.user_id)
+            {
+                user_done = TRUE;
+                break;
+            }
+        }
+        if (user_done != FALSE)
+        {
+            continue;
+        }
+        done_user_ids[nb_done_users++] = temp_entry.user_id;
+        
+        /* Keep track of the latest change numbers for which this user is losing entries */
+        nodemgmt_read_change_journal_user_record(temp_entry.user_id, &user_record);
+        if ((user_record.last_missing_cred_change_number != UINT32_MAX) && ((temp_entry.cred_change_number > user_record.last_missing_cred_change_number) || (temp_entry.data_change_number > user_record.last_missing_data_change_number)))
+        {
+            if (temp_entry.cred_change_number > user_record.last_missing_cred_change_number)
+            {
+                user_record.last_missing_cred_change_number = temp_entry.cred_change_number;
+            }
+            if (temp_entry.data_change_number > user_record.last_missing_data_change_number)
+            {
+                user_record.last_missing_data_change_number = temp_entry.data_change_number;
+            }
+            nodemgmt_write_change_journal_user_record(temp_entry.user_id, &user_record);
+        }
+    }
+    
+    dbflash_page_erase(&dbflash_descriptor, nodemgmt_get_change_journal_slot_page(first_slot));
+}
+
+/*! \fn     nodemgmt_scan_change_journal(void)
+*   \brief  Find the next change journal slot to be written and start tracking the current user changes if needed
+*   \note   Slots are written in a circular way and the page following the one being written is always erased, so the next slot to be written is the only empty slot following a written one
+*/
+static void nodemgmt_scan_change_journal(void)
+{
+    uint16_t nb_pages = nodemgmt_get_change_journal_nb_slots() / NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE;
+    nodemgmt_change_journal_user_record_t user_record;
+    nodemgmt_change_journal_entry_t temp_entry;
+    BOOL prev_page_last_slot_written;
+    uint16_t nb_full_pages = 0;
+    
+    nodemgmt_current_handle.changeJournalLoggingEnabled = TRUE;
+    nodemgmt_current_handle.changeJournalNbPending = 0;
+    nodemgmt_current_handle.changeJournalWriteSlot = 0;
+    
+    /* Changes not tracked for this user yet: we may have missed changes up to now */
+    nodemgmt_read_change_journal_user_record(nodemgmt_current_handle.currentUserId, &user_record);
+    if (user_record.last_missing_cred_change_number == UINT32_MAX)
+    {
+        user_record.last_missing_cred_change_number = nodemgmt_get_cred_change_number();
+        user_record.last_missing_data_change_number = nodemgmt_get_data_change_number();
+        nodemgmt_write_change_journal_user_record(nodemgmt_current_handle.currentUserId, &user_record);
+    }
+    
+    /* Last slot of the last page */
+    nodemgmt_read_change_journal_slot(nb_pages*NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE - 1, &temp_entry);
+    prev_page_last_slot_written = (temp_entry.user_id == UINT16_MAX)? FALSE : TRUE;
+    
+    /* Look at the first and last slots of each page */
+    for (uint16_t i = 0; i < nb_pages; i++)
+    {
+        uint16_t first_slot = i*NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE;
+        
+        nodemgmt_read_change_journal_slot(first_slot, &temp_entry);
+        if (temp_entry.user_id == UINT16_MAX)
+        {
+            /* Empty page following a full one */
+            if (prev_page_last_slot_written != FALSE)
+            {
+                nodemgmt_current_handle.changeJournalWriteSlot = first_slot;
+                return;
+            }
+            prev_page_last_slot_written = FALSE;
+        }
+        else
+        {
+            nodemgmt_read_change_journal_slot(first_slot + NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE - 1, &temp_entry);
+            if (temp_entry.user_id == UINT16_MAX)
+            {
+                /* Partially written page: look for its first empty slot */
+                for (uint16_t j = first_slot + 1; j < first_slot + NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE; j++)
+                {
+                    nodemgmt_read_change_journal_slot(j, &temp_entry);
+                    if (temp_entry.user_id == UINT16_MAX)
+                    {
+                        nodemgmt_current_handle.changeJournalWriteSlot = j;
+                        return;
+                    }
+                }
+            }
+            prev_page_last_slot_written = TRUE;
+            nb_full_pages++;
+        }
+    }
+    
+    /* Only full pages (interrupted eviction): start over from the first page, keeping track of what is lost */
+    if (nb_full_pages == nb_pages)
+    {
+        nodemgmt_evict_change_journal_page(0);
+    }
+}
+
+/*! \fn     nodemgmt_flush_change_journal(void)
+*   \brief  Write the pending change journal entries to flash
+*   \note   When a page gets full, the next one is evicted
+*/
+static void nodemgmt_flush_change_journal(void)
+{
+    uint16_t nb_slots = nodemgmt_get_change_journal_nb_slots();
+    uint16_t nb_flushed_entries = 0;
+    
+    while (nb_flushed_entries < nodemgmt_current_handle.changeJournalNbPending)
+    {
+        uint16_t write_slot = nodemgmt_current_handle.changeJournalWriteSlot;
+        uint16_t slot_in_page = write_slot % NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE;
+        uint16_t nb_entries_to_write = nodemgmt_current_handle.changeJournalNbPending - nb_flushed_entries;
+        
+        /* Write as many entries as we can in the current page */
+        if (nb_entries_to_write > NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE - slot_in_page)
+        {
+            nb_entries_to_write = NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE - slot_in_page;
+        }
+        dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_get_change_journal_slot_page(write_slot), slot_in_page*sizeof(nodemgmt_change_journal_entry_t), nb_entries_to_write*sizeof(nodemgmt_change_journal_entry_t), (void*)&nodemgmt_current_handle.changeJournalPending[nb_flushed_entries]);
+        nb_flushed_entries += nb_entries_to_write;
+        write_slot += nb_entries_to_write;
+        
+        /* Page full: evict the next one */
+        if ((write_slot % NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE) == 0)
+        {
+            if (write_slot >= nb_slots)
+            {
+                write_slot = 0;
+            }
+            nodemgmt_evict_change_journal_page(write_slot);
+        }
+        
+        nodemgmt_current_handle.changeJournalWriteSlot = write_slot;
+    }
+    
+    nodemgmt_current_handle.changeJournalNbPending = 0;
+}
+
+/*! \fn     nodemgmt_log_node_change(uint16_t address)
+*   \brief  Add a written / erased node address to the change journal
+*   \param  address     Node address
+*   \note   Entries are kept in RAM until the next flush
+*/
+static void nodemgmt_log_node_change(uint16_t address)
+{
+    nodemgmt_change_journal_entry_t new_entry;
+    new_entry.user_id = nodemgmt_current_handle.currentUserId;
+    new_entry.node_address = address;
+    new_entry.cred_change_number = nodemgmt_get_cred_change_number();
+    new_entry.data_change_number = nodemgmt_get_data_change_number();
+    
+    /* User being deleted */
+    if (nodemgmt_current_handle.changeJournalLoggingEnabled == FALSE)
+    {
+        return;
+    }
+    
+    /* Same entry already pending? */
+    for (uint16_t i = 0; i < nodemgmt_current_handle.changeJournalNbPending; i++)
+    {
+        if (memcmp(&nodemgmt_current_handle.changeJournalPending[i], &new_entry, sizeof(new_entry)) == 0)
+        {
+            return;
+        }
+    }
+    
+    /* Pending buffer full? */
+    if (nodemgmt_current_handle.changeJournalNbPending == MEMBER_ARRAY_SIZE(nodemgmtHandle_t, changeJournalPending))
+    {
+        nodemgmt_flush_change_journal();
+    }
+    nodemgmt_current_handle.changeJournalPending[nodemgmt_current_handle.changeJournalNbPending++] = new_entry;
+}
+
+/*! \fn     nodemgmt_stop_change_journal_tracking(void)
+*   \brief  Stop logging the current user changes, drop the pending entries and erase the user record
+*   \note   To be called when the current user is deleted, so that its nodes deletion doesn't evict other users entries
+*/
+static void nodemgmt_stop_change_journal_tracking(void)
+{
+    nodemgmt_change_journal_user_record_t user_record;
+    
+    nodemgmt_current_handle.changeJournalLoggingEnabled = FALSE;
+    nodemgmt_current_handle.changeJournalNbPending = 0;
+    
+    memset(&user_record, 0xFF, sizeof(user_record));
+    nodemgmt_write_change_journal_user_record(nodemgmt_current_handle.currentUserId, &user_record);
+}
+
+/*! \fn     nodemgmt_get_changed_node_addresses(uint32_t cred_change_number, uint32_t data_change_number, uint16_t nb_to_skip, uint16_t* addresses, uint16_t max_nb_addresses, uint16_t* nb_addresses, BOOL* more_addresses)
+*   \brief  Get the addresses of the nodes written / erased by the current user since given change numbers
+*   \param  cred_change_number  Credential change number from which we want the changes
+*   \param  data_change_number  Data change number from which we want the changes
+*   \param  nb_to_skip          Number of matching addresses to skip (for subsequent calls)
+*   \param  addresses           Where to store the addresses, oldest change first
+*   \param  max_nb_addresses    Addresses buffer length
+*   \param  nb_addresses        Where to store the number of addresses written
+*   \param  more_addresses      Where to store if more addresses are available
+*   \return RETURN_NOK if the change journal lost entries of the current user since these change numbers (full resync required)
+*   \note   Addresses may be listed several times
+*   \note   The journal is shared by all users (entries are tagged with their user ID) and lives in the unused bonding information pages of sector 0, as a user profile has no spare bytes for it
+*   \note   Each user has a record of the latest change numbers for which its entries were lost: no tracking yet, or entries evicted by newer ones (from any user)
+*/
+RET_TYPE nodemgmt_get_changed_node_addresses(uint32_t cred_change_number, uint32_t data_change_number, uint16_t nb_to_skip, uint16_t* addresses, uint16_t max_nb_addresses, uint16_t* nb_addresses, BOOL* more_addresses)
+{
+    uint16_t nb_slots = nodemgmt_get_change_journal_nb_slots();
+    nodemgmt_change_journal_user_record_t user_record;
+    nodemgmt_change_journal_entry_t temp_entry;
+    
+    *more_addresses = FALSE;
+    *nb_addresses = 0;
+    
+    /* Write pending entries */
+    nodemgmt_flush_change_journal();
+    
+    /* Check that we have all the changes since the provided change numbers (an untracked user record is all 0xFF) */
+    nodemgmt_read_change_journal_user_record(nodemgmt_current_handle.currentUserId, &user_record);
+    if ((cred_change_number <= user_record.last_missing_cred_change_number) && (data_change_number <= user_record.last_missing_data_change_number))
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Go through the entries, oldest first */
+    for (uint16_t i = 0; i < nb_slots; i++)
+    {
+        uint16_t slot = nodemgmt_current_handle.changeJournalWriteSlot + i;
+        if (slot >= nb_slots)
+        {
+            slot -= nb_slots;
+        }
+        
+        nodemgmt_read_change_journal_slot(slot, &temp_entry);
+        if ((temp_entry.user_id == nodemgmt_current_handle.currentUserId) && (temp_entry.cred_change_number >= cred_change_number) && (temp_entry.data_change_number >= data_change_number))
+        {
+            if (nb_to_skip != 0)
+            {
+                nb_to_skip--;
+            }
+            else if (*nb_addresses < max_nb_addresses)
+            {
+                addresses[(*nb_addresses)++] = temp_entry.node_address;
+            }
+            else
+            {
+                *more_addresses = TRUE;
+                break;
+            }
+        }
+    }
+    
+    return RETURN_OK;
+}
+
+/*! \fn     nodemgmt_invalidate_page_hash_tree(void)
+*   \brief  Invalidate all the page hash tree leaves
+*/
+static inline void nodemgmt_invalidate_page_hash_tree(void)
+{
+    memset(nodemgmt_current_handle.pageHashLeavesValid, 0, sizeof(nodemgmt_current_handle.pageHashLeavesValid));
+}
+
+/*! \fn     nodemgmt_invalidate_page_hash(uint16_t address)
+*   \brief  Invalidate the page hash tree leaf for a given node address
+*   \param  address     A valid node address (sector 0 excluded)
+*/
+static inline void nodemgmt_invalidate_page_hash(uint16_t address)
+{
+    uint16_t leaf_id = (nodemgmt_page_from_address(address) - PAGE_PER_SECTOR) / NODEMGMT_PAGE_HASH_PAGES_PER_LEAF;
+    nodemgmt_current_handle.pageHashLeavesValid[leaf_id >> 5] &= ~(1UL << (leaf_id & 0x1F));
+}
+
+/*! \fn     nodemgmt_compute_page_hash_tree_leaf(uint16_t leaf_id)
+*   \brief  Compute a page hash tree leaf: truncated SHA256 of the [address][base node] pairs for the current user's base nodes in the leaf pages
+*   \param  leaf_id     Leaf ID
+*   \return The hash, 0 if the leaf doesn't contain any of the current user nodes
+*/
+static uint32_t nodemgmt_compute_page_hash_tree_leaf(uint16_t leaf_id)
+{
+    uint16_t start_page = PAGE_PER_SECTOR + leaf_id*NODEMGMT_PAGE_HASH_PAGES_PER_LEAF;
+    uint16_t stop_page = start_page + NODEMGMT_PAGE_HASH_PAGES_PER_LEAF;
+    uint8_t hash[32];
+    uint8_t temp_buffer[BASE_NODE_SIZE/4];
+    BOOL user_node_found = FALSE;
+    uint16_t flags;
+    
+    _Static_assert(BASE_NODE_SIZE % 4 == 0, "Base node can't be read in 4 chunks");
+    
+    /* Padding leaves */
+    if (start_page >= PAGE_COUNT)
+    {
+        return 0;
+    }
+    if (stop_page > PAGE_COUNT)
+    {
+        stop_page = PAGE_COUNT;
+    }
+    
+    for (uint16_t page = start_page; page < stop_page; page++)
+    {
+        for (uint16_t node = 0; node < NODEMGMT_NB_NODES_PER_PAGE; node++)
+        {
+            uint16_t address = constructAddress(page, node);
+            
+            /* Only hash the current user nodes */
+            dbflash_read_data_from_flash(&dbflash_descriptor, page, BASE_NODE_SIZE*node, sizeof(flags), (void*)&flags);
+            if ((flags == UINT16_MAX) || (userIdFromFlags(flags) != nodemgmt_current_handle.currentUserId))
+            {
+                continue;
+            }
+            
+            if (user_node_found == FALSE)
+            {
+                logic_encryption_sha256_init();
+                user_node_found = TRUE;
+            }
+            
+            /* Address then node contents */
+            logic_encryption_sha256_update((uint8_t*)&address, sizeof(address));
+            for (uint16_t i = 0; i < 4; i++)
+            {
+                dbflash_read_data_from_flash(&dbflash_descriptor, page, BASE_NODE_SIZE*node + i*sizeof(temp_buffer), sizeof(temp_buffer), (void*)temp_buffer);
+                logic_encryption_sha256_update(temp_buffer, sizeof(temp_buffer));
+            }
+        }
+    }
+    
+    if (user_node_found == FALSE)
+    {
+        return 0;
+    }
+    logic_encryption_sha256_final(hash);
+    return ((uint32_t)hash[0]) | (((uint32_t)hash[1]) << 8) | (((uint32_t)hash[2]) << 16) | (((uint32_t)hash[3]) << 24);
+}
+
+/*! \fn     nodemgmt_get_page_hash_tree_node(uint16_t tree_node)
+*   \brief  Get a page hash tree node hash from the cached leaves
+*   \param  tree_node   Tree node index (1 for the root)
+*   \return The hash: leaf hash for leaves, truncated SHA256 of both children hashes otherwise (0 if both are 0)
+*   \note   All the leaves below that tree node must be up to date. Internal nodes aren't cached: at most NODEMGMT_PAGE_HASH_NB_LEAVES-1 small hashes per call
+*/
+static uint32_t nodemgmt_get_page_hash_tree_node(uint16_t tree_node)
+{
+    uint32_t children_hashes[2];
+    uint8_t hash[32];
+    
+    if (tree_node >= NODEMGMT_PAGE_HASH_NB_LEAVES)
+    {
+        return nodemgmt_current_handle.pageHashLeaves[tree_node - NODEMGMT_PAGE_HASH_NB_LEAVES];
+    }
+    
+    children_hashes[0] = nodemgmt_get_page_hash_tree_node(2*tree_node);
+    children_hashes[1] = nodemgmt_get_page_hash_tree_node(2*tree_node + 1);
+    if ((children_hashes[0] == 0) && (children_hashes[1] == 0))
+    {
+        return 0;
+    }
+    
+    logic_encryption_sha256_init();
+    logic_encryption_sha256_update((uint8_t*)children_hashes, sizeof(children_hashes));
+    logic_encryption_sha256_final(hash);
+    return ((uint32_t)hash[0]) | (((uint32_t)hash[1]) << 8) | (((uint32_t)hash[2]) << 16) | (((uint32_t)hash[3]) << 24);
+}
+
+/*! \fn     nodemgmt_update_page_hash_tree_leaves(uint16_t tree_node, uint16_t* nb_leaves_budget)
+*   \brief  Compute the out of date leaves below a page hash tree node, within a given budget
+*   \param  tree_node           Tree node index (1 for the root)
+*   \param  nb_leaves_budget    Number of leaves we're still allowed to compute, decremented for each computed leaf
+*   \return RETURN_OK if all the leaves below that tree node are up to date
+*/
+static RET_TYPE nodemgmt_update_page_hash_tree_leaves(uint16_t tree_node, uint16_t* nb_leaves_budget)
+{
+    uint16_t first_leaf_id = tree_node;
+    uint16_t last_leaf_id = tree_node;
+    
+    /* Leaves below that tree node */
+    while (first_leaf_id < NODEMGMT_PAGE_HASH_NB_LEAVES)
+    {
+        first_leaf_id = 2*first_leaf_id;
+        last_leaf_id = 2*last_leaf_id + 1;
+    }
+    first_leaf_id -= NODEMGMT_PAGE_HASH_NB_LEAVES;
+    last_leaf_id -= NODEMGMT_PAGE_HASH_NB_LEAVES;
+    
+    for (uint16_t leaf_id = first_leaf_id; leaf_id <= last_leaf_id; leaf_id++)
+    {
+        if ((nodemgmt_current_handle.pageHashLeavesValid[leaf_id >> 5] & (1UL << (leaf_id & 0x1F))) == 0)
+        {
+            if (*nb_leaves_budget == 0)
+            {
+                return RETURN_NOK;
+            }
+            (*nb_leaves_budget)--;
+            nodemgmt_current_handle.pageHashLeaves[leaf_id] = nodemgmt_compute_page_hash_tree_leaf(leaf_id);
+            nodemgmt_current_handle.pageHashLeavesValid[leaf_id >> 5] |= (1UL << (leaf_id & 0x1F));
+        }
+    }
+    
+    return RETURN_OK;
+}
+
+/*! \fn     nodemgmt_get_page_hash_tree_hashes(uint16_t first_tree_node, uint16_t nb_tree_nodes, uint32_t* hashes)
+*   \brief  Get consecutive page hash tree node hashes, for host / device database diffing
+*   \param  first_tree_node Index of the first tree node: 1 for the root, children of i at 2i & 2i+1, leaves from NODEMGMT_PAGE_HASH_NB_LEAVES
+*   \param  nb_tree_nodes   Number of tree nodes
+*   \param  hashes          Where to store the hashes
+*   \return RETURN_PHASH_INVALID_NODES for invalid tree node indexes, RETURN_PHASH_NOT_READY if out of date leaves remain (call again)
+*   \note   Leaf n covers the NODEMGMT_PAGE_HASH_PAGES_PER_LEAF pages starting at PAGE_PER_SECTOR + n*NODEMGMT_PAGE_HASH_PAGES_PER_LEAF
+*   \note   At most NODEMGMT_PAGE_HASH_LEAVES_PER_CALL leaves are computed per call, so that the main loop isn't blocked
+*/
+page_hash_ret_te nodemgmt_get_page_hash_tree_hashes(uint16_t first_tree_node, uint16_t nb_tree_nodes, uint32_t* hashes)
+{
+    uint16_t nb_leaves_budget = NODEMGMT_PAGE_HASH_LEAVES_PER_CALL;
+    
+    if ((first_tree_node == 0) || (nb_tree_nodes == 0) || ((uint32_t)first_tree_node + nb_tree_nodes > 2*NODEMGMT_PAGE_HASH_NB_LEAVES))
+    {
+        return RETURN_PHASH_INVALID_NODES;
+    }
+    
+    /* Bring the leaves we need up to date */
+    for (uint16_t i = 0; i < nb_tree_nodes; i++)
+    {
+        if (nodemgmt_update_page_hash_tree_leaves(first_tree_node + i, &nb_leaves_budget) != RETURN_OK)
+        {
+            return RETURN_PHASH_NOT_READY;
+        }
+    }
+    
+    for (uint16_t i = 0; i < nb_tree_nodes; i++)
+    {
+        hashes[i] = nodemgmt_get_page_hash_tree_node(first_tree_node + i);
+    }
+    
+    return RETURN_PHASH_OK;
+}
+
+/*! \fn     nodemgmt_erase_node_slot(uint16_t address, BOOL log_change)
+*   \brief  Erase a node slot in flash, mark it as free and remove it from the service index
+*   \param  address     A valid node address (sector 0 excluded)
+*   \param  log_change  Set to TRUE to add the address to the change journal (FALSE for the second half of child nodes)
+*/
+static void nodemgmt_erase_node_slot(uint16_t address, BOOL log_change)
+{
+    if (log_change != FALSE)
+    {
+        nodemgmt_log_node_change(address);
+    }
+    nodemgmt_invalidate_page_hash(address);
+    
+    dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), BASE_NODE_SIZE, 0xFF);
+    nodemgmt_update_node_usage_bitmap(address, UINT16_MAX);
+    nodemgmt_remove_from_service_index(address);
+}
+
 /*! \fn     nodemgmt_construct_date(uint16_t year, uint16_t month, uint16_t day)
 *   \brief  Packs a uint16_t type with a date code in format YYYYYYYMMMMDDDDD. Year Offset from 2010
 *   \param  year            The year to pack into the uint16_t
@@ -268,6 +1105,9 @@ void nodemgmt_write_parent_node_data_block_to_flash(uint16_t address, parent_nod
     nodemgmt_check_address_validity_and_lock(address);
     nodemgmt_user_id_to_flags(&(parent_node->cred_parent.flags), nodemgmt_current_handle.currentUserId);
     dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), BASE_NODE_SIZE, (void*)parent_node->node_as_bytes);
+    nodemgmt_update_node_usage_bitmap(address, parent_node->cred_parent.flags);
+    nodemgmt_invalidate_page_hash(address);
+    nodemgmt_log_node_change(address);
 }
 
 /*! \fn     nodemgmt_write_child_node_block_to_flash(uint16_t address, child_node_t* child_node, BOOL write_category)
@@ -292,10 +1132,190 @@ void nodemgmt_write_child_node_block_to_flash(uint16_t address, child_node_t* ch
         nodemgmt_categoryflags_to_flags(&(child_node->cred_child.fakeFlags), nodemgmt_current_handle.currentCategoryFlags);
     }
     
-    /* Write to flash */
+    /* Category change of an existing child: we don't know its parent, so forget all the children categories */
     nodemgmt_check_address_validity_and_lock(address);
+    if (nodemgmt_current_handle.serviceIndexValid != FALSE)
+    {
+        uint16_t prev_flags;
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), sizeof(prev_flags), (void*)&prev_flags);
+        if ((validBitFromFlags(prev_flags) == NODEMGMT_VBIT_VALID) && (categoryFromFlags(prev_flags) != categoryFromFlags(child_node->cred_child.flags)))
+        {
+            nodemgmt_reset_service_index_categories();
+        }
+    }
+    
+    /* Write to flash */
     dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), BASE_NODE_SIZE, (void*)child_node->node_as_bytes);
     dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE, (void*)(&child_node->node_as_bytes[BASE_NODE_SIZE]));
+    
+    /* Update node usage bitmap: second half starts with the fake flags */
+    nodemgmt_update_node_usage_bitmap(address, child_node->cred_child.flags);
+    nodemgmt_update_node_usage_bitmap(nodemgmt_get_incremented_address(address), child_node->cred_child.fakeFlags);
+    nodemgmt_invalidate_page_hash(nodemgmt_get_incremented_address(address));
+    nodemgmt_invalidate_page_hash(address);
+    nodemgmt_log_node_change(address);
+}
+
+#if NODEMGMT_NB_NODES_PER_PAGE > 1
+/*! \fn     nodemgmt_get_node_write_request_block_address(nodemgmt_node_write_request_t* write_requests, uint16_t block_id)
+*   \brief  Get the address of a given base node block of a batched node write
+*   \param  write_requests  Array of write requests
+*   \param  block_id        Block ID: 2*request index for the first block, 2*request index+1 for the second half of a child node
+*   \return The block address, NODE_ADDR_NULL if the block doesn't exist
+*/
+static uint16_t nodemgmt_get_node_write_request_block_address(nodemgmt_node_write_request_t* write_requests, uint16_t block_id)
+{
+    nodemgmt_node_write_request_t* write_request_pt = &write_requests[block_id/2];
+    
+    if ((block_id & 0x01) == 0)
+    {
+        return write_request_pt->address;
+    }
+    else if (write_request_pt->node_size == sizeof(child_node_t))
+    {
+        return nodemgmt_get_incremented_address(write_request_pt->address);
+    }
+    else
+    {
+        return NODE_ADDR_NULL;
+    }
+}
+
+#endif
+
+/*! \fn     nodemgmt_write_node_blocks_to_flash(nodemgmt_node_write_request_t* write_requests, uint16_t nb_write_requests)
+*   \brief  Write several parent / child node data blocks to flash, programming each touched flash page only once
+*   \param  write_requests      Array of write requests
+*   \param  nb_write_requests   Number of write requests
+*   \note   Same flag enforcement as nodemgmt_write_parent_node_data_block_to_flash & nodemgmt_write_child_node_block_to_flash (no category write)
+*   \note   If several requests target the same node, the last one wins
+*   \note   Pages are only coalesced when a flash page holds several nodes, otherwise nodes are written one after the other
+*/
+void nodemgmt_write_node_blocks_to_flash(nodemgmt_node_write_request_t* write_requests, uint16_t nb_write_requests)
+{
+#if NODEMGMT_NB_NODES_PER_PAGE == 1
+    /* Sanity checks */
+    if (nb_write_requests > NODEMGMT_MAX_NB_NODE_WRITES)
+    {
+        main_reboot();
+    }
+    for (uint16_t i = 0; i < nb_write_requests; i++)
+    {
+        if ((write_requests[i].node_size != sizeof(parent_node_t)) && (write_requests[i].node_size != sizeof(child_node_t)))
+        {
+            main_reboot();
+        }
+    }
+    
+    /* One node per page: nothing to coalesce, each block write already is a single page program */
+    for (uint16_t i = 0; i < nb_write_requests; i++)
+    {
+        if (write_requests[i].node_size == sizeof(parent_node_t))
+        {
+            nodemgmt_write_parent_node_data_block_to_flash(write_requests[i].address, (parent_node_t*)write_requests[i].node_pt);
+        }
+        else
+        {
+            nodemgmt_write_child_node_block_to_flash(write_requests[i].address, (child_node_t*)write_requests[i].node_pt, FALSE);
+        }
+    }
+#else
+    _Static_assert(2*NODEMGMT_MAX_NB_NODE_WRITES <= 32, "Too many node writes for the written blocks bitmask");
+    _Static_assert(NODEMGMT_NB_NODES_PER_PAGE <= 16, "Too many nodes per page for the page slots bitmask");
+    uint32_t written_blocks_bitmask = 0;
+    
+    /* Sanity checks */
+    if (nb_write_requests > NODEMGMT_MAX_NB_NODE_WRITES)
+    {
+        main_reboot();
+    }
+    
+    /* Enforce user ID and check addresses */
+    for (uint16_t i = 0; i < nb_write_requests; i++)
+    {
+        nodemgmt_check_address_validity_and_lock(write_requests[i].address);
+        
+        if (write_requests[i].node_size == sizeof(parent_node_t))
+        {
+            parent_node_t* parent_node = (parent_node_t*)write_requests[i].node_pt;
+            nodemgmt_user_id_to_flags(&(parent_node->cred_parent.flags), nodemgmt_current_handle.currentUserId);
+        }
+        else if (write_requests[i].node_size == sizeof(child_node_t))
+        {
+            child_node_t* child_node = (child_node_t*)write_requests[i].node_pt;
+            nodemgmt_check_address_validity_and_lock(nodemgmt_get_incremented_address(write_requests[i].address));
+            nodemgmt_user_id_to_flags(&(child_node->cred_child.flags), nodemgmt_current_handle.currentUserId);
+            nodemgmt_user_id_to_flags(&(child_node->cred_child.fakeFlags), nodemgmt_current_handle.currentUserId);
+            child_node->cred_child.fakeFlags |= (NODEMGMT_VBIT_INVALID << NODEMGMT_CORRECT_FLAGS_BIT_BITSHIFT);
+        }
+        else
+        {
+            main_reboot();
+        }
+    }
+    
+    /* Each request is split in base node blocks: block 2*i is the first (or only) block of request i, block 2*i+1 the second half of a child node */
+    for (uint16_t i = 0; i < 2*nb_write_requests; i++)
+    {
+        uint16_t block_address = nodemgmt_get_node_write_request_block_address(write_requests, i);
+        
+        /* Skip non existing blocks and blocks already written */
+        if ((block_address == NODE_ADDR_NULL) || ((written_blocks_bitmask & (1UL << i)) != 0))
+        {
+            continue;
+        }
+        
+        /* Find the slots of the block page that will be written */
+        uint16_t page_number = nodemgmt_page_from_address(block_address);
+        uint16_t page_slots_bitmask = 0;
+        for (uint16_t j = i; j < 2*nb_write_requests; j++)
+        {
+            uint16_t other_block_address = nodemgmt_get_node_write_request_block_address(write_requests, j);
+            if ((other_block_address != NODE_ADDR_NULL) && (nodemgmt_page_from_address(other_block_address) == page_number))
+            {
+                page_slots_bitmask |= (1 << nodemgmt_node_from_address(other_block_address));
+            }
+        }
+        
+        /* Only load the page contents if we're not overwriting all of it */
+        if (page_slots_bitmask != ((1 << NODEMGMT_NB_NODES_PER_PAGE) - 1))
+        {
+            dbflash_load_page_to_internal_buffer(&dbflash_descriptor, page_number);
+        }
+        
+        /* Write all the blocks for that page in the flash buffer, in request order */
+        for (uint16_t j = i; j < 2*nb_write_requests; j++)
+        {
+            uint16_t other_block_address = nodemgmt_get_node_write_request_block_address(write_requests, j);
+            if ((other_block_address != NODE_ADDR_NULL) && (nodemgmt_page_from_address(other_block_address) == page_number))
+            {
+                dbflash_write_data_to_internal_buffer(&dbflash_descriptor, BASE_NODE_SIZE * nodemgmt_node_from_address(other_block_address), BASE_NODE_SIZE, &(((uint8_t*)write_requests[j/2].node_pt)[(j & 0x01)*BASE_NODE_SIZE]));
+                written_blocks_bitmask |= (1UL << j);
+            }
+        }
+        
+        /* One program cycle for that page */
+        dbflash_flash_write_buffer_to_page(&dbflash_descriptor, page_number);
+    }
+    
+    /* Update node usage bitmap & page hash tree, log the changes, in request order */
+    for (uint16_t i = 0; i < nb_write_requests; i++)
+    {
+        nodemgmt_invalidate_page_hash(write_requests[i].address);
+        nodemgmt_log_node_change(write_requests[i].address);
+        if (write_requests[i].node_size == sizeof(parent_node_t))
+        {
+            nodemgmt_update_node_usage_bitmap(write_requests[i].address, ((parent_node_t*)write_requests[i].node_pt)->cred_parent.flags);
+        }
+        else
+        {
+            child_node_t* child_node = (child_node_t*)write_requests[i].node_pt;
+            nodemgmt_update_node_usage_bitmap(write_requests[i].address, child_node->cred_child.flags);
+            nodemgmt_update_node_usage_bitmap(nodemgmt_get_incremented_address(write_requests[i].address), child_node->cred_child.fakeFlags);
+            nodemgmt_invalidate_page_hash(nodemgmt_get_incremented_address(write_requests[i].address));
+        }
+    }
+#endif
 }
 
 /*! \fn     nodemgmt_read_parent_node_data_block_from_flash(uint16_t address, parent_node_t* parent_node)
@@ -708,19 +1728,20 @@ void nodemgmt_format_user_profile(uint16_t uid, uint16_t secPreferences, uint16_
  */
 void nodemgmt_delete_all_bluetooth_bonding_information(void)
 {
-    uint16_t starting_page, stop_page;
+    uint16_t starting_page, stop_page, temp_page;
     
      /* Compute the offset: after the last user profile */
     #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
         starting_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START*2;
-        stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP*2;
     #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
         starting_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START;
-        stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP;
     #else
         #error "User profile isn't a multiple of page size"
     #endif
     
+    /* Stop at the change journal */
+    nodemgmt_get_change_journal_pages(&stop_page, &temp_page);
+    
     /* Erase pages one after the other */
     for (uint16_t page = starting_page; page < stop_page; page++)
     {
@@ -1162,7 +2183,86 @@ uint16_t nodemgmt_check_for_logins_with_category_in_parent_node(uint16_t start_c
         next_child_node_addr_to_scan = child_node_pt->nextChildAddress;
     }
     
-    return NODE_ADDR_NULL;
+    return NODE_ADDR_NULL;
+}
+
+/*! \fn     nodemgmt_get_categories_in_children(uint16_t start_child_addr)
+ *  \brief  Go through a children list to know which categories are present
+ *  \param  start_child_addr    Address of the first child
+ *  \return serviceIndexCategories bits of the children categories, with NODEMGMT_SERVICE_INDEX_CATS_KNOWN set
+ */
+static uint8_t nodemgmt_get_categories_in_children(uint16_t start_child_addr)
+{
+    uint16_t next_child_node_addr_to_scan = start_child_addr;
+    uint8_t categories = NODEMGMT_SERVICE_INDEX_CATS_KNOWN;
+    uint16_t child_read_buffer[4];
+    
+    /* Hack to read flags & prev / next address, see nodemgmt_check_for_logins_with_category_in_parent_node */
+    child_cred_node_t* child_node_pt = (child_cred_node_t*)child_read_buffer;
+    
+    /* Loop in children */
+    while (next_child_node_addr_to_scan != NODE_ADDR_NULL)
+    {
+        /* Read flags and prev/next address */
+        nodemgmt_check_address_validity_and_lock(next_child_node_addr_to_scan);
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_child_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(next_child_node_addr_to_scan), sizeof(child_read_buffer), &child_read_buffer);
+        
+        /* Store category */
+        categories |= nodemgmt_get_service_index_category_bit(categoryFromFlags(child_node_pt->flags));
+        
+        /* Go to next child if there's any */
+        next_child_node_addr_to_scan = child_node_pt->nextChildAddress;
+    }
+    
+    return categories;
+}
+
+/*! \fn     nodemgmt_check_service_index_categories(uint8_t categories, uint16_t category_flags)
+ *  \brief  See if computed service index children categories contain the desired category
+ *  \param  categories          Children categories, see nodemgmt_get_categories_in_children
+ *  \param  category_flags      Desired category flags
+ *  \return TRUE if at least one child has the desired category
+ */
+static inline BOOL nodemgmt_check_service_index_categories(uint8_t categories, uint16_t category_flags)
+{
+    // CATSEARCHLOGIC
+    if (category_flags == 0)
+    {
+        return ((categories & ~NODEMGMT_SERVICE_INDEX_CATS_KNOWN) != 0)? TRUE:FALSE;
+    }
+    else
+    {
+        return ((categories & nodemgmt_get_service_index_category_bit(category_flags) & ~NODEMGMT_SERVICE_INDEX_CATS_OTHER) != 0)? TRUE:FALSE;
+    }
+}
+
+/*! \fn     nodemgmt_check_for_logins_with_category_in_cred_parent(uint16_t parent_addr, uint16_t start_child_addr, uint16_t credential_type_id, uint16_t category_flags)
+ *  \brief  See if a credential parent node contains children that have the desired category, using the service index children categories
+ *  \param  parent_addr         Parent node address
+ *  \param  start_child_addr    Address of the parent first child
+ *  \param  credential_type_id  Credential type ID
+ *  \param  category_flags      Desired category flags
+ *  \return TRUE if the parent has at least one child with the desired category
+ *  \note   Children are only walked the first time, or when the parent isn't in the service index
+ */
+static BOOL nodemgmt_check_for_logins_with_category_in_cred_parent(uint16_t parent_addr, uint16_t start_child_addr, uint16_t credential_type_id, uint16_t category_flags)
+{
+    nodemgmt_service_index_entry_t* entry_pt = nodemgmt_get_service_index_entry(credential_type_id, parent_addr);
+    
+    /* Not in the index */
+    if (entry_pt == 0)
+    {
+        return (nodemgmt_check_for_logins_with_category_in_parent_node(start_child_addr, category_flags) != NODE_ADDR_NULL)? TRUE:FALSE;
+    }
+    
+    /* Children categories not computed yet */
+    uint8_t* categories_pt = &nodemgmt_current_handle.serviceIndexCategories[entry_pt - nodemgmt_current_handle.serviceIndex];
+    if ((*categories_pt & NODEMGMT_SERVICE_INDEX_CATS_KNOWN) == 0)
+    {
+        *categories_pt = nodemgmt_get_categories_in_children(start_child_addr);
+    }
+    
+    return nodemgmt_check_service_index_categories(*categories_pt, category_flags);
 }
 
 /*! \fn     nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_parent_addr, uint16_t credential_type_id)
@@ -1205,7 +2305,7 @@ uint16_t nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_pa
         /* Check if the last node could work */
         nodemgmt_check_address_validity_and_lock(search_start_parent_addr);
         dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(search_start_parent_addr), BASE_NODE_SIZE*nodemgmt_node_from_address(search_start_parent_addr), sizeof(parent_read_buffer), &parent_read_buffer);
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_cred_parent(search_start_parent_addr, parent_node_pt->nextChildAddress, credential_type_id, nodemgmt_current_handle.currentCategoryFlags) != FALSE)
         {
                 return search_start_parent_addr;
         }
@@ -1224,7 +2324,7 @@ uint16_t nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_pa
         dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(prev_parent_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(prev_parent_node_addr_to_scan), sizeof(parent_read_buffer), &parent_read_buffer);
 
         /* Check for logins with desired category */
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_cred_parent(prev_parent_node_addr_to_scan, parent_node_pt->nextChildAddress, credential_type_id, nodemgmt_current_handle.currentCategoryFlags) != FALSE)
         {
             return prev_parent_node_addr_to_scan;
         }
@@ -1283,7 +2383,7 @@ uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_pa
         next_parent_node_addr_to_scan = parent_node_pt->nextParentAddress;
         
         /* Check that the provided parent node actually belongs to the current category.... */
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) == NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_cred_parent(search_start_parent_addr, parent_node_pt->nextChildAddress, credential_type_id, nodemgmt_current_handle.currentCategoryFlags) == FALSE)
         {
             return NODE_ADDR_NULL;
         }
@@ -1303,7 +2403,7 @@ uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_pa
         dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_parent_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(next_parent_node_addr_to_scan), sizeof(parent_read_buffer), &parent_read_buffer);
 
         /* Check for logins with desired category */
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_cred_parent(next_parent_node_addr_to_scan, parent_node_pt->nextChildAddress, credential_type_id, nodemgmt_current_handle.currentCategoryFlags) != FALSE)
         {
             /* Check for single credential */
             if (next_parent_node_addr_to_scan == search_start_parent_addr)
@@ -1681,221 +2781,599 @@ int32_t nodemgmt_get_next_non_null_favorite_after_index(uint16_t favId, uint16_t
         }
         if (navigate_across_categories != FALSE)
         {
-            start_category_id = 0;
+            start_category_id = 0;
+        }
+    }
+    
+    return -1;
+}
+
+/*! \fn     nodemgmt_get_next_non_null_favorite_before_index(uint16_t favId, uint16_t category_id, BOOL navigate_across_categories)
+ *  \brief  Get a non-null favorite ID after a given one
+ *  \param  favId                       The id number at which we should start looking for favs
+ *  \param  category_id                 The category ID
+ *  \param  navigate_across_categories  Boolean to specify if we're allowed to navigate across categories
+ *  \return A favorite ID (MSB) and category ID (LSB) or -1
+ */
+int32_t nodemgmt_get_next_non_null_favorite_before_index(uint16_t favId, uint16_t category_id, BOOL navigate_across_categories)
+{
+    uint16_t end_category_id = (navigate_across_categories != FALSE) ? 0 : category_id;
+    uint16_t start_category_id = category_id;
+    favorite_addr_t favorite;
+    
+    /* Sanity checks */
+    if ((favId >= (MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites[0].favorite))) || (category_id >= (MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites))))
+    {
+        return -1;
+    }
+    
+    /* Start looking */
+    for (int16_t i = favId; i >= 0; i--)
+    {
+        for (int16_t j = start_category_id; j >= end_category_id; j--)
+        {
+            // Read from flash
+            dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, category_favorites[j].favorite[i]), sizeof(favorite), (void*)&favorite);
+
+            // Valid favorite?
+            if ((favorite.child_addr != NODE_ADDR_NULL) && (favorite.parent_addr != NODE_ADDR_NULL))
+            {
+                return (((uint32_t)i) << 16) | j;
+            }            
+        }
+        if (navigate_across_categories != FALSE)
+        {
+            start_category_id = MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites) - 1;
+        }
+    }
+    
+    return -1;
+}
+
+/*! \fn     nodemgmt_get_favorites(uint16_t* addresses_array)
+ *  \brief  Get all favorites at once
+ *  \param  addresses_array     Where to store them
+ *  \return Number of favorites written
+ */
+uint16_t nodemgmt_get_favorites(uint16_t* addresses_array)
+{
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, category_favorites), MEMBER_SIZE(nodemgmt_userprofile_t,category_favorites), (void*)addresses_array);
+    return MEMBER_SIZE(nodemgmt_userprofile_t,category_favorites)/sizeof(favorite_addr_t);
+}
+
+/*! \fn     nodemgmt_read_profile_ctr(void* buf)
+ *  \brief  Reads the users base CTR from the user profile flash memory
+ *  \param  buf             The buffer to store the read CTR
+ */
+void nodemgmt_read_profile_ctr(void* buf)
+{
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, main_data.current_ctr), MEMBER_SIZE(nodemgmt_userprofile_t, main_data.current_ctr), buf);
+}
+
+/*! \fn     nodemgmt_set_profile_ctr(void* buf)
+ *  \brief  Sets the user DB change number in the user profile flash memory
+ *  \param  buf             The buffer containing the new CTR
+ */
+void nodemgmt_set_profile_ctr(void* buf)
+{
+    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, main_data.current_ctr), MEMBER_SIZE(nodemgmt_userprofile_t, main_data.current_ctr), buf);
+}
+
+/*! \fn     nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+ *  \brief  Get all category strings at once
+ *  \param  strings_pt  Where to store the strings
+ */
+void nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+{
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings, sizeof(nodemgmt_user_category_strings_t), strings_pt);
+    strings_pt->category_strings[0][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+    strings_pt->category_strings[1][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+    strings_pt->category_strings[2][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+    strings_pt->category_strings[3][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+}
+
+/*! \fn     nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+ *  \brief  Set all category strings at once
+ *  \param  strings_pt  Where the strings are stored
+ */
+void nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+{
+    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings, sizeof(nodemgmt_user_category_strings_t), strings_pt);
+}
+
+/*! \fn     nodemgmt_get_category_string(uint16_t string_id, cust_char_t* string_pt)
+ *  \brief  Get a given user category string
+ *  \param  category_id     Category ID
+ *  \param  string_pt       Where to store the category string   
+ */
+void nodemgmt_get_category_string(uint16_t category_id, cust_char_t* string_pt)
+{
+    if (category_id >= MEMBER_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings))
+    {
+        return;
+    }
+    
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings + (size_t)offsetof(nodemgmt_user_category_strings_t, category_strings[category_id]), MEMBER_SIZE(nodemgmt_user_category_strings_t, category_strings[0]), string_pt);
+    string_pt[MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+}
+
+/*! \fn     nodemgmt_set_category_string(uint16_t string_id, cust_char_t* string_pt)
+ *  \brief  Set a given user category string
+ *  \param  category_id     Category ID
+ *  \param  string_pt       Where to store the category string 
+ *  \note   Input buffer must have at least the same size as the filesystem category string field  
+ */
+void nodemgmt_set_category_string(uint16_t category_id, cust_char_t* string_pt)
+{
+    if (category_id >= MEMBER_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings))
+    {
+        return;
+    }
+    
+    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings + (size_t)offsetof(nodemgmt_user_category_strings_t, category_strings[category_id]), MEMBER_SIZE(nodemgmt_user_category_strings_t, category_strings[0]), string_pt);
+}
+
+/*! \fn     nodemgmt_build_node_usage_bitmap_word(uint16_t word_index)
+*   \brief  Scan our external memory node flags to build a node usage bitmap word, if not done yet
+*   \param  word_index  Index of the bitmap word (32 node slots)
+*   \note   The bitmap is built on demand by nodemgmt_find_free_nodes, so that a login only scans the node slots up to the first free ones
+*/
+static void nodemgmt_build_node_usage_bitmap_word(uint16_t word_index)
+{
+    uint32_t bitmap_word = 0;
+    uint16_t nodeFlags;
+    
+    /* Sanity check */
+    _Static_assert((NODEMGMT_NB_NODE_SLOTS % 32) == 0, "Node slots number isn't a multiple of the bitmap word size");
+    
+    // Already built?
+    if ((nodemgmt_current_handle.nodeUsageBitmapBuilt[word_index >> 5] & (1UL << (word_index & 0x1F))) != 0)
+    {
+        return;
+    }
+    
+    // for each node slot in that word
+    for (uint16_t bitItr = 0; bitItr < 32; bitItr++)
+    {
+        uint16_t slot_address = nodemgmt_get_address_from_node_slot_index((word_index << 5) + bitItr);
+        
+        // read node flags (2 bytes - fixed size)
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(slot_address), BASE_NODE_SIZE*nodemgmt_node_from_address(slot_address), sizeof(nodeFlags), &nodeFlags);
+        if (validBitFromFlags(nodeFlags) == NODEMGMT_VBIT_VALID)
+        {
+            bitmap_word |= (1UL << bitItr);
+        }
+    }
+    
+    // Node writes & deletes may have already set bits in that word: flash contents take precedence
+    nodemgmt_current_handle.nodeUsageBitmap[word_index] = bitmap_word;
+    nodemgmt_current_handle.nodeUsageBitmapBuilt[word_index >> 5] |= (1UL << (word_index & 0x1F));
+}
+
+/*! \fn     nodemgmt_find_free_nodes(uint16_t nbParentNodes, uint16_t* parentNodeArray, uint16_t nbChildtNodes, uint16_t* childNodeArray, uint16_t startPage, uint16_t startNode)
+*   \brief  Find Free Nodes inside our external memory
+*   \param  nbParentNodes   Number of parent nodes we want to find
+*   \param  parentNodeArray An array where to store the addresses
+*   \param  nbChildtNodes   Number of child nodes we want to find
+*   \param  childNodeArray  An array where to store the addresses
+*   \param  startPage       Page where to start the scanning
+*   \param  startNode       Scan start node address inside the start page
+*   \return the number of nodes found
+*   \note   Lookup is done in the node usage bitmap, flash is only read for the bitmap words not built yet
+*/
+uint16_t nodemgmt_find_free_nodes(uint16_t nbParentNodes, uint16_t* parentNodeArray, uint16_t nbChildtNodes, uint16_t* childNodeArray, uint16_t startPage, uint16_t startNode)
+{
+    uint16_t prevFreeAddressFound = NODE_ADDR_NULL;
+    uint16_t nbParentNodesFound = 0;
+    uint16_t nbChildNodesFound = 0;
+    uint32_t slotItr;
+    
+#ifdef EMULATOR_BUILD
+    if(emu_get_failure_flags() & EMU_FAIL_DBFLASH_FULL)
+        return 0;
+#endif
+
+    // Check the start page
+    if (startPage < PAGE_PER_SECTOR)
+    {
+        startPage = PAGE_PER_SECTOR;
+    }
+    
+    // Nothing to scan after the last page
+    if (startPage >= PAGE_COUNT)
+    {
+        return 0;
+    }
+
+    // for each node slot, starting at the provided page & node
+    for (slotItr = ((uint32_t)(startPage - PAGE_PER_SECTOR) * NODEMGMT_NB_NODES_PER_PAGE) + startNode; slotItr < NODEMGMT_NB_NODE_SLOTS; slotItr++)
+    {
+        nodemgmt_build_node_usage_bitmap_word((uint16_t)(slotItr >> 5));
+        uint32_t bitmap_word = nodemgmt_current_handle.nodeUsageBitmap[slotItr >> 5];
+        
+        // Skip fully used bitmap words
+        if (((slotItr & 0x1F) == 0) && (bitmap_word == UINT32_MAX))
+        {
+            prevFreeAddressFound = NODE_ADDR_NULL;
+            slotItr += 31;
+            continue;
+        }
+        
+        // If this slot is OK
+        if ((bitmap_word & (1UL << (slotItr & 0x1F))) == 0)
+        {
+            // fill parent nodes first (only one block)
+            if (nbParentNodesFound != nbParentNodes)
+            {
+                parentNodeArray[nbParentNodesFound++] = nodemgmt_get_address_from_node_slot_index((uint16_t)slotItr);
+                
+                // check for end
+                if ((nbChildtNodes == 0) && (nbParentNodesFound == nbParentNodes))
+                {
+                    return nbChildNodesFound+nbParentNodesFound;
+                }
+            } 
+            else
+            {
+                if (prevFreeAddressFound == NODE_ADDR_NULL)
+                {
+                    // Store address if the next free block found is available
+                    prevFreeAddressFound = nodemgmt_get_address_from_node_slot_index((uint16_t)slotItr);
+                } 
+                else
+                {
+                    childNodeArray[nbChildNodesFound++] = prevFreeAddressFound;
+                    prevFreeAddressFound = NODE_ADDR_NULL;
+                    
+                    // check for end
+                    if (nbChildNodesFound == nbChildtNodes)
+                    {
+                        return nbChildNodesFound+nbParentNodesFound;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // block found isn't available, reset flag
+            prevFreeAddressFound = NODE_ADDR_NULL;
+        }
+    }
+    
+    return nbChildNodesFound+nbParentNodesFound;
+}
+
+/*! \fn     nodemgmt_get_service_hash(cust_char_t* service, uint16_t max_length)
+*   \brief  Compute the service index hash of a service name
+*   \param  service     The service name
+*   \param  max_length  Max number of characters to consider, if no terminating 0 is found before
+*   \return The hash (FNV-1a, folded on 15 bits)
+*/
+uint16_t nodemgmt_get_service_hash(cust_char_t* service, uint16_t max_length)
+{
+    uint32_t hash = 2166136261UL;
+    
+    for (uint16_t i = 0; (i < max_length) && (service[i] != 0); i++)
+    {
+        hash ^= service[i];
+        hash *= 16777619UL;
+    }
+    
+    return (uint16_t)((hash >> 15) ^ hash) & NODEMGMT_SERVICE_INDEX_HASH_MASK;
+}
+
+/*! \fn     nodemgmt_read_parent_node_service(uint16_t address, parent_node_t* parent_node)
+*   \brief  Read a parent node flags, addresses and service name, for the service index
+*   \param  address     Where to read
+*   \param  parent_node Pointer to the node, only filled up to the service name terminating 0
+*   \return RETURN_OK if the data is valid
+*   \note   Same checks as nodemgmt_read_parent_node_permissive, service name is read NODEMGMT_SERVICE_INDEX_READ_CHUNK characters at a time
+*/
+static RET_TYPE nodemgmt_read_parent_node_service(uint16_t address, parent_node_t* parent_node)
+{
+    uint16_t nb_chars_read = NODEMGMT_SERVICE_INDEX_READ_CHUNK;
+    uint16_t max_nb_chars;
+    
+    /* Sanity check: mult domain service shares its first characters with the service */
+    _Static_assert(offsetof(parent_cred_node_t, service) == offsetof(parent_cred_node_t, service_and_mult_dom.service), "Mult domain service isn't at the service offset");
+    _Static_assert(offsetof(parent_cred_node_t, service) == offsetof(parent_data_node_t, service), "Data parent service isn't at the cred parent service offset");
+    
+    /* Check for correct address */
+    if (nodemgmt_check_address_validity(address) != RETURN_OK)
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Read flags, addresses and service first characters */
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), offsetof(parent_cred_node_t, service) + nb_chars_read*sizeof(cust_char_t), (void*)parent_node->node_as_bytes);
+    
+    /* Check permission */
+    if (nodemgmt_check_user_perm_from_flags(parent_node->cred_parent.flags) != RETURN_OK)
+    {
+        return RETURN_NOK;
+    }
+    
+    /* Number of characters used by nodemgmt_compute_service_index_hash */
+    if ((parent_node->cred_parent.flags & NODEMGMT_MULT_DOMAIN_FLAG) != 0)
+    {
+        max_nb_chars = MEMBER_ARRAY_SIZE(shorten_service_with_mult_dom_t, service)-1;
+    }
+    else
+    {
+        max_nb_chars = MEMBER_ARRAY_SIZE(parent_cred_node_t, service)-1;
+    }
+    
+    /* Read the next characters until the terminating 0 */
+    for (uint16_t i = 0; i < max_nb_chars; i++)
+    {
+        if (i == nb_chars_read)
+        {
+            uint16_t nb_chars_to_read = (max_nb_chars - i < NODEMGMT_SERVICE_INDEX_READ_CHUNK)? max_nb_chars - i : NODEMGMT_SERVICE_INDEX_READ_CHUNK;
+            dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address) + offsetof(parent_cred_node_t, service) + i*sizeof(cust_char_t), nb_chars_to_read*sizeof(cust_char_t), (void*)&parent_node->cred_parent.service[i]);
+            nb_chars_read += nb_chars_to_read;
+        }
+        
+        if (parent_node->cred_parent.service[i] == 0)
+        {
+            break;
         }
     }
     
-    return -1;
+    return RETURN_OK;
 }
 
-/*! \fn     nodemgmt_get_next_non_null_favorite_before_index(uint16_t favId, uint16_t category_id, BOOL navigate_across_categories)
- *  \brief  Get a non-null favorite ID after a given one
- *  \param  favId                       The id number at which we should start looking for favs
- *  \param  category_id                 The category ID
- *  \param  navigate_across_categories  Boolean to specify if we're allowed to navigate across categories
- *  \return A favorite ID (MSB) and category ID (LSB) or -1
- */
-int32_t nodemgmt_get_next_non_null_favorite_before_index(uint16_t favId, uint16_t category_id, BOOL navigate_across_categories)
+/*! \fn     nodemgmt_build_service_index(void)
+*   \brief  Go through all the parent lists to build the service index
+*   \note   Service index is left invalid if it isn't big enough or if a parent can't be read
+*   \note   Only the parents flags, addresses and service names are read
+*/
+static void nodemgmt_build_service_index(void)
 {
-    uint16_t end_category_id = (navigate_across_categories != FALSE) ? 0 : category_id;
-    uint16_t start_category_id = category_id;
-    favorite_addr_t favorite;
+    uint16_t nb_entries = 0;
     
-    /* Sanity checks */
-    if ((favId >= (MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites[0].favorite))) || (category_id >= (MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites))))
-    {
-        return -1;
-    }
+    /* Start from an empty invalid index */
+    nodemgmt_current_handle.serviceIndexValid = FALSE;
+    memset(nodemgmt_current_handle.serviceIndexCounts, 0, sizeof(nodemgmt_current_handle.serviceIndexCounts));
     
-    /* Start looking */
-    for (int16_t i = favId; i >= 0; i--)
+    /* Sanity check */
+    _Static_assert(MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts) == MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes) + MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstDataParentNodes), "Incorrect service index counts array size");
+    
+    /* Go through each list */
+    for (uint16_t list_id = 0; list_id < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndexCounts); list_id++)
     {
-        for (int16_t j = start_category_id; j >= end_category_id; j--)
+        uint16_t next_node_addr;
+        
+        if (list_id < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes))
         {
-            // Read from flash
-            dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, category_favorites[j].favorite[i]), sizeof(favorite), (void*)&favorite);
-
-            // Valid favorite?
-            if ((favorite.child_addr != NODE_ADDR_NULL) && (favorite.parent_addr != NODE_ADDR_NULL))
+            next_node_addr = nodemgmt_current_handle.firstCredParentNodes[list_id];
+        } 
+        else
+        {
+            next_node_addr = nodemgmt_current_handle.firstDataParentNodes[list_id - MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes)];
+        }
+        
+        uint16_t list_start_index = nb_entries;
+        cust_char_t list_first_char = 0;
+        cust_char_t prev_first_char = 0;
+        
+        while (next_node_addr != NODE_ADDR_NULL)
+        {
+            /* Index full (also catches database loops) or invalid node */
+            if ((nb_entries >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, serviceIndex)) || (nodemgmt_read_parent_node_service(next_node_addr, &nodemgmt_current_handle.temp_parent_node) != RETURN_OK))
             {
-                return (((uint32_t)i) << 16) | j;
-            }            
+                return;
+            }
+            
+            /* Store entry */
+            nodemgmt_current_handle.serviceIndex[nb_entries].address = next_node_addr;
+            nodemgmt_current_handle.serviceIndexCategories[nb_entries] = 0;
+            nodemgmt_current_handle.serviceIndex[nb_entries].hash = nodemgmt_compute_service_index_hash(&nodemgmt_current_handle.temp_parent_node);
+            
+            /* New letter flag, the list first entry is done once we know the last letter */
+            if (nb_entries == list_start_index)
+            {
+                list_first_char = nodemgmt_current_handle.temp_parent_node.cred_parent.service[0];
+            }
+            else if (nodemgmt_current_handle.temp_parent_node.cred_parent.service[0] != prev_first_char)
+            {
+                nodemgmt_current_handle.serviceIndex[nb_entries].hash |= NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG;
+            }
+            prev_first_char = nodemgmt_current_handle.temp_parent_node.cred_parent.service[0];
+            
+            nb_entries++;
+            nodemgmt_current_handle.serviceIndexCounts[list_id]++;
+            next_node_addr = nodemgmt_current_handle.temp_parent_node.cred_parent.nextParentAddress;
         }
-        if (navigate_across_categories != FALSE)
+        
+        /* List first entry new letter flag */
+        if ((nb_entries != list_start_index) && (list_first_char != prev_first_char))
         {
-            start_category_id = MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites) - 1;
+            nodemgmt_current_handle.serviceIndex[list_start_index].hash |= NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG;
         }
     }
     
-    return -1;
+    nodemgmt_current_handle.serviceIndexValid = TRUE;
 }
 
-/*! \fn     nodemgmt_get_favorites(uint16_t* addresses_array)
- *  \brief  Get all favorites at once
- *  \param  addresses_array     Where to store them
- *  \return Number of favorites written
- */
-uint16_t nodemgmt_get_favorites(uint16_t* addresses_array)
+/*! \fn     nodemgmt_invalidate_service_index(void)
+*   \brief  Invalidate the service index, to be called before the database is externally changed
+*   \note   Index is rebuilt by nodemgmt_trigger_db_ext_changed_actions or at next login
+*/
+void nodemgmt_invalidate_service_index(void)
 {
-    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, category_favorites), MEMBER_SIZE(nodemgmt_userprofile_t,category_favorites), (void*)addresses_array);
-    return MEMBER_SIZE(nodemgmt_userprofile_t,category_favorites)/sizeof(favorite_addr_t);
+    nodemgmt_current_handle.serviceIndexValid = FALSE;
 }
 
-/*! \fn     nodemgmt_read_profile_ctr(void* buf)
- *  \brief  Reads the users base CTR from the user profile flash memory
- *  \param  buf             The buffer to store the read CTR
- */
-void nodemgmt_read_profile_ctr(void* buf)
+/*! \fn     nodemgmt_is_service_index_valid(void)
+*   \brief  Know if the service index can be used
+*   \return The boolean
+*/
+BOOL nodemgmt_is_service_index_valid(void)
 {
-    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, main_data.current_ctr), MEMBER_SIZE(nodemgmt_userprofile_t, main_data.current_ctr), buf);
+    return nodemgmt_current_handle.serviceIndexValid;
 }
 
-/*! \fn     nodemgmt_set_profile_ctr(void* buf)
- *  \brief  Sets the user DB change number in the user profile flash memory
- *  \param  buf             The buffer containing the new CTR
- */
-void nodemgmt_set_profile_ctr(void* buf)
+/*! \fn     nodemgmt_get_next_service_index_candidate(BOOL data_parent, uint16_t type_id, uint16_t service_hash, BOOL include_mult_domain, uint16_t* iterator)
+*   \brief  Get the next parent address in a given list which service may match the provided hash
+*   \param  data_parent         Set to TRUE to look in data parent lists
+*   \param  type_id             Credential / data type ID
+*   \param  service_hash        Service hash, see nodemgmt_get_service_hash
+*   \param  include_mult_domain Set to TRUE to also return all multiple domain parents
+*   \param  iterator            Position in the list, to be set to 0 before the first call
+*   \return Candidate address (in alphabetical order) or NODE_ADDR_NULL
+*   \note   Only use when nodemgmt_is_service_index_valid returns TRUE, candidates must be checked by reading the parent
+*/
+uint16_t nodemgmt_get_next_service_index_candidate(BOOL data_parent, uint16_t type_id, uint16_t service_hash, BOOL include_mult_domain, uint16_t* iterator)
 {
-    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserProfile, nodemgmt_current_handle.offsetUserProfile + (size_t)offsetof(nodemgmt_userprofile_t, main_data.current_ctr), MEMBER_SIZE(nodemgmt_userprofile_t, main_data.current_ctr), buf);
+    uint16_t list_id = type_id;
+    
+    /* Compute list id & boundary checks */
+    if (data_parent != FALSE)
+    {
+        if (type_id >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstDataParentNodes))
+        {
+            return NODE_ADDR_NULL;
+        }
+        list_id += MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes);
+    }
+    else if (type_id >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes))
+    {
+        return NODE_ADDR_NULL;
+    }
+    
+    /* Go through the entries */
+    uint16_t start_index = nodemgmt_get_service_index_list_start(list_id);
+    while (*iterator < nodemgmt_current_handle.serviceIndexCounts[list_id])
+    {
+        nodemgmt_service_index_entry_t* entry_pt = &nodemgmt_current_handle.serviceIndex[start_index + (*iterator)++];
+        
+        if (((entry_pt->hash & ~NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG) == service_hash) || ((include_mult_domain != FALSE) && ((entry_pt->hash & NODEMGMT_SERVICE_INDEX_MULT_DOMAIN_FLAG) != 0)))
+        {
+            return entry_pt->address;
+        }
+    }
+    
+    return NODE_ADDR_NULL;
 }
 
-/*! \fn     nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt)
- *  \brief  Get all category strings at once
- *  \param  strings_pt  Where to store the strings
- */
-void nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+/*! \fn     nodemgmt_get_service_index_nb_entries(uint16_t credential_type_id)
+*   \brief  Get the number of service index entries for a given credential type
+*   \param  credential_type_id  Credential type ID
+*   \return Number of entries, 0 if the service index isn't valid
+*/
+uint16_t nodemgmt_get_service_index_nb_entries(uint16_t credential_type_id)
 {
-    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings, sizeof(nodemgmt_user_category_strings_t), strings_pt);
-    strings_pt->category_strings[0][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
-    strings_pt->category_strings[1][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
-    strings_pt->category_strings[2][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
-    strings_pt->category_strings[3][MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+    if ((nodemgmt_current_handle.serviceIndexValid == FALSE) || (credential_type_id >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes)))
+    {
+        return 0;
+    }
+    
+    return nodemgmt_current_handle.serviceIndexCounts[credential_type_id];
 }
 
-/*! \fn     nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt)
- *  \brief  Set all category strings at once
- *  \param  strings_pt  Where the strings are stored
- */
-void nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt)
+/*! \fn     nodemgmt_get_service_index_position(uint16_t credential_type_id, uint16_t parent_addr)
+*   \brief  Get the position of a given credential parent in the service index
+*   \param  credential_type_id  Credential type ID
+*   \param  parent_addr         Parent address
+*   \return Position (alphabetical order) or NODEMGMT_SERVICE_INDEX_POS_INVALID
+*/
+uint16_t nodemgmt_get_service_index_position(uint16_t credential_type_id, uint16_t parent_addr)
 {
-    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings, sizeof(nodemgmt_user_category_strings_t), strings_pt);
+    nodemgmt_service_index_entry_t* entry_pt;
+    
+    /* Boundary checks */
+    if (credential_type_id >= MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes))
+    {
+        return NODEMGMT_SERVICE_INDEX_POS_INVALID;
+    }
+    
+    entry_pt = nodemgmt_get_service_index_entry(credential_type_id, parent_addr);
+    if (entry_pt == 0)
+    {
+        return NODEMGMT_SERVICE_INDEX_POS_INVALID;
+    }
+    
+    return (uint16_t)(entry_pt - &nodemgmt_current_handle.serviceIndex[nodemgmt_get_service_index_list_start(credential_type_id)]);
 }
 
-/*! \fn     nodemgmt_get_category_string(uint16_t string_id, cust_char_t* string_pt)
- *  \brief  Get a given user category string
- *  \param  category_id     Category ID
- *  \param  string_pt       Where to store the category string   
- */
-void nodemgmt_get_category_string(uint16_t category_id, cust_char_t* string_pt)
+/*! \fn     nodemgmt_get_service_index_entry_for_cur_category(uint16_t credential_type_id, uint16_t position)
+*   \brief  Get a credential parent from the service index if it has logins in the current category
+*   \param  credential_type_id  Credential type ID
+*   \param  position            Position in the service index, smaller than nodemgmt_get_service_index_nb_entries()
+*   \return Parent address or NODE_ADDR_NULL if the parent doesn't have logins in the current category
+*   \note   Only reads flash the first time the parent children categories are needed
+*/
+uint16_t nodemgmt_get_service_index_entry_for_cur_category(uint16_t credential_type_id, uint16_t position)
 {
-    if (category_id >= MEMBER_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings))
+    uint16_t parent_read_buffer[4];
+    uint16_t entry_index;
+    uint16_t parent_addr;
+    
+    /* Sanity check for this hack */
+    _Static_assert(6 == offsetof(parent_cred_node_t, nextChildAddress), "Incorrect buffer for flags & addr read");
+    _Static_assert(sizeof(parent_read_buffer) == offsetof(parent_cred_node_t, nextChildAddress) + MEMBER_SIZE(parent_cred_node_t, nextChildAddress), "Incorrect buffer for flags & addr read");
+    
+    /* Hack to read flags, prev / next address */
+    parent_cred_node_t* parent_node_pt = (parent_cred_node_t*)parent_read_buffer;
+    
+    /* Boundary checks */
+    if (position >= nodemgmt_get_service_index_nb_entries(credential_type_id))
     {
-        return;
+        return NODE_ADDR_NULL;
     }
+    entry_index = nodemgmt_get_service_index_list_start(credential_type_id) + position;
+    parent_addr = nodemgmt_current_handle.serviceIndex[entry_index].address;
     
-    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings + (size_t)offsetof(nodemgmt_user_category_strings_t, category_strings[category_id]), MEMBER_SIZE(nodemgmt_user_category_strings_t, category_strings[0]), string_pt);
-    string_pt[MEMBER_SUB_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings)-1] = 0;
+    /* Children categories not computed yet: read the first child address */
+    if ((nodemgmt_current_handle.serviceIndexCategories[entry_index] & NODEMGMT_SERVICE_INDEX_CATS_KNOWN) == 0)
+    {
+        nodemgmt_check_address_validity_and_lock(parent_addr);
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(parent_addr), BASE_NODE_SIZE*nodemgmt_node_from_address(parent_addr), sizeof(parent_read_buffer), &parent_read_buffer);
+        nodemgmt_current_handle.serviceIndexCategories[entry_index] = nodemgmt_get_categories_in_children(parent_node_pt->nextChildAddress);
+    }
+    
+    /* Check for logins in current category */
+    if (nodemgmt_check_service_index_categories(nodemgmt_current_handle.serviceIndexCategories[entry_index], nodemgmt_current_handle.currentCategoryFlags) == FALSE)
+    {
+        return NODE_ADDR_NULL;
+    }
+    
+    return parent_addr;
 }
 
-/*! \fn     nodemgmt_set_category_string(uint16_t string_id, cust_char_t* string_pt)
- *  \brief  Set a given user category string
- *  \param  category_id     Category ID
- *  \param  string_pt       Where to store the category string 
- *  \note   Input buffer must have at least the same size as the filesystem category string field  
- */
-void nodemgmt_set_category_string(uint16_t category_id, cust_char_t* string_pt)
+/*! \fn     nodemgmt_is_service_index_entry_new_letter(uint16_t credential_type_id, uint16_t position)
+*   \brief  Know if a service index entry first letter differs from the previous entry one
+*   \param  credential_type_id  Credential type ID
+*   \param  position            Position in the service index, smaller than nodemgmt_get_service_index_nb_entries()
+*   \return The boolean, the first entry being compared with the last one
+*/
+BOOL nodemgmt_is_service_index_entry_new_letter(uint16_t credential_type_id, uint16_t position)
 {
-    if (category_id >= MEMBER_ARRAY_SIZE(nodemgmt_user_category_strings_t, category_strings))
+    /* Boundary checks */
+    if (position >= nodemgmt_get_service_index_nb_entries(credential_type_id))
     {
-        return;
+        return FALSE;
     }
     
-    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_current_handle.pageUserCategoryStrings, nodemgmt_current_handle.offsetUserCategoryStrings + (size_t)offsetof(nodemgmt_user_category_strings_t, category_strings[category_id]), MEMBER_SIZE(nodemgmt_user_category_strings_t, category_strings[0]), string_pt);
+    return ((nodemgmt_current_handle.serviceIndex[nodemgmt_get_service_index_list_start(credential_type_id) + position].hash & NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG) != 0)? TRUE:FALSE;
 }
 
-/*! \fn     nodemgmt_find_free_nodes(uint16_t nbParentNodes, uint16_t* parentNodeArray, uint16_t nbChildtNodes, uint16_t* childNodeArray, uint16_t startPage, uint16_t startNode)
-*   \brief  Find Free Nodes inside our external memory
-*   \param  nbParentNodes   Number of parent nodes we want to find
-*   \param  parentNodeArray An array where to store the addresses
-*   \param  nbChildtNodes   Number of child nodes we want to find
-*   \param  childNodeArray  An array where to store the addresses
-*   \param  startPage       Page where to start the scanning
-*   \param  startNode       Scan start node address inside the start page
-*   \return the number of nodes found
+/*! \fn     nodemgmt_get_service_index_entry_first_char(uint16_t credential_type_id, uint16_t position)
+*   \brief  Get a service index entry first letter
+*   \param  credential_type_id  Credential type ID
+*   \param  position            Position in the service index, smaller than nodemgmt_get_service_index_nb_entries()
+*   \return The first letter, 0 for an invalid position
+*   \note   Reads the letter from flash: use nodemgmt_is_service_index_entry_new_letter to only read it when it changes
 */
-uint16_t nodemgmt_find_free_nodes(uint16_t nbParentNodes, uint16_t* parentNodeArray, uint16_t nbChildtNodes, uint16_t* childNodeArray, uint16_t startPage, uint16_t startNode)
+cust_char_t nodemgmt_get_service_index_entry_first_char(uint16_t credential_type_id, uint16_t position)
 {
-    uint16_t prevFreeAddressFound = NODE_ADDR_NULL;
-    uint16_t nbParentNodesFound = 0;
-    uint16_t nbChildNodesFound = 0;
-    uint16_t nodeFlags;
-    uint16_t pageItr;
-    uint16_t nodeItr;
-    
-#ifdef EMULATOR_BUILD
-    if(emu_get_failure_flags() & EMU_FAIL_DBFLASH_FULL)
-        return 0;
-#endif
-
-    // Check the start page
-    if (startPage < PAGE_PER_SECTOR)
+    /* Boundary checks */
+    if (position >= nodemgmt_get_service_index_nb_entries(credential_type_id))
     {
-        startPage = PAGE_PER_SECTOR;
+        return 0;
     }
-
-    // for each page
-    for(pageItr = startPage; pageItr < PAGE_COUNT; pageItr++)
-    {
-        // for each possible parent node in the page (changes per flash chip)
-        for(nodeItr = startNode; nodeItr < BYTES_PER_PAGE/BASE_NODE_SIZE; nodeItr++)
-        {
-            // read node flags (2 bytes - fixed size)
-            dbflash_read_data_from_flash(&dbflash_descriptor, pageItr, BASE_NODE_SIZE*nodeItr, sizeof(nodeFlags), &nodeFlags);
-            
-            // If this slot is OK
-            if(validBitFromFlags(nodeFlags) == NODEMGMT_VBIT_INVALID)
-            {
-                // fill parent nodes first (only one block)
-                if (nbParentNodesFound != nbParentNodes)
-                {
-                    parentNodeArray[nbParentNodesFound++] = constructAddress(pageItr, nodeItr);
-                    
-                    // check for end
-                    if ((nbChildtNodes == 0) && (nbParentNodesFound == nbParentNodes))
-                    {
-                        return nbChildNodesFound+nbParentNodesFound;
-                    }
-                } 
-                else
-                {
-                    if (prevFreeAddressFound == NODE_ADDR_NULL)
-                    {
-                        // Store address if the next free block found is available
-                        prevFreeAddressFound = constructAddress(pageItr, nodeItr);
-                    } 
-                    else
-                    {
-                        childNodeArray[nbChildNodesFound++] = prevFreeAddressFound;
-                        prevFreeAddressFound = NODE_ADDR_NULL;
-                        
-                        // check for end
-                        if (nbChildNodesFound == nbChildtNodes)
-                        {
-                            return nbChildNodesFound+nbParentNodesFound;
-                        }
-                    }
-                }
-            }
-            else
-            {
-                // block found isn't available, reset flag
-                prevFreeAddressFound = NODE_ADDR_NULL;
-            }
-        }
-        startNode = 0;
-    }    
     
-    return nbChildNodesFound+nbParentNodesFound;
+    return nodemgmt_read_parent_service_first_char(nodemgmt_current_handle.serviceIndex[nodemgmt_get_service_index_list_start(credential_type_id) + position].address);
 }
 
 /*! \fn     nodemgmt_trigger_db_ext_changed_actions(void)
@@ -1905,15 +3383,21 @@ void nodemgmt_trigger_db_ext_changed_actions(void)
 {
     // Scan last parent nodes
     nodemgmt_scan_for_last_parent_nodes();
+    
+    // Rebuild service index
+    nodemgmt_build_service_index();
+    
+    // Write pending change journal entries
+    nodemgmt_flush_change_journal();
 }
 
 /*! \fn     nodemgmt_scan_node_usage(void)
-*   \brief  Scan memory to find empty slots
+*   \brief  Scan node usage bitmap to find empty slots
 */
 void nodemgmt_scan_node_usage(void)
 {
-    // Find one free node. If we don't find it, set the next to the null addr, we start looking from the just taken node
-    if (nodemgmt_find_free_nodes(1, &nodemgmt_current_handle.nextParentFreeNode, 1, &nodemgmt_current_handle.nextChildFreeNode, nodemgmt_page_from_address(nodemgmt_current_handle.nextParentFreeNode), nodemgmt_node_from_address(nodemgmt_current_handle.nextParentFreeNode)) != 2)
+    // Find one free node. If we don't find it, set the next to the null addr. Bitmap lookup is cheap: start from the beginning of the memory to reuse freed slots
+    if (nodemgmt_find_free_nodes(1, &nodemgmt_current_handle.nextParentFreeNode, 1, &nodemgmt_current_handle.nextChildFreeNode, PAGE_PER_SECTOR, 0) != 2)
     {
         nodemgmt_current_handle.nextParentFreeNode = NODE_ADDR_NULL;
         nodemgmt_current_handle.nextChildFreeNode = NODE_ADDR_NULL;
@@ -2201,6 +3685,9 @@ void nodemgmt_init_context(uint16_t userIdNum, uint16_t* userSecFlags, uint16_t*
     _Static_assert(MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstDataParentNodes) == MEMBER_ARRAY_SIZE(nodemgmt_profile_main_data_t, data_start_addresses), "Data start addresses array incorrect size");
     _Static_assert(sizeof(generic_node_t) == 2*BASE_NODE_SIZE, "Invalid Node Sizes");
             
+    // Write pending change journal entries from the previous user
+    nodemgmt_flush_change_journal();
+    
     // fill current user id, first parent node address, user profile page & offset
     nodemgmt_get_user_category_names_starting_offset(userIdNum, &nodemgmt_current_handle.pageUserCategoryStrings, &nodemgmt_current_handle.offsetUserCategoryStrings);
     nodemgmt_get_user_profile_starting_offset(userIdNum, &nodemgmt_current_handle.pageUserProfile, &nodemgmt_current_handle.offsetUserProfile);
@@ -2223,9 +3710,19 @@ void nodemgmt_init_context(uint16_t userIdNum, uint16_t* userSecFlags, uint16_t*
     // Scan for last parent nodes
     nodemgmt_scan_for_last_parent_nodes();
     
-    // scan for next free parent and child nodes from the start of the memory
+    // node usage bitmap is built on demand: look for next free parent and child nodes from the start of the memory
+    memset(nodemgmt_current_handle.nodeUsageBitmapBuilt, 0, sizeof(nodemgmt_current_handle.nodeUsageBitmapBuilt));
     nodemgmt_scan_node_usage();
     
+    // Build service index
+    nodemgmt_build_service_index();
+    
+    // Fetch change journal state
+    nodemgmt_scan_change_journal();
+    
+    // Page hash tree is computed on demand
+    nodemgmt_invalidate_page_hash_tree();
+    
     // Check if the number of known languages/layouts is different from the one we currently have, and reset the language if so
     if ((profile_main_data.nb_languages_known != custom_fs_get_number_of_languages()) || (profile_main_data.nb_keyboards_layout_known != custom_fs_get_number_of_keyb_layouts()))
     {
@@ -2268,6 +3765,9 @@ void nodemgmt_user_db_changed_actions(BOOL dataChanged)
         nodemgmt_current_handle.datadbChanged = TRUE;
         nodemgmt_set_data_change_number(current_data_change_number);        
     }
+    
+    // Write pending change journal entries
+    nodemgmt_flush_change_journal();
 }
 
 /*! \fn     nodemgmt_delete_data_parent_and_its_children(uint16_t parent_address, uint16_t typeId)
@@ -2325,7 +3825,7 @@ void nodemgmt_delete_data_parent_and_its_children(uint16_t parent_address, uint1
     }
     
     // Delete parent data block
-    dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(parent_address), BASE_NODE_SIZE * nodemgmt_node_from_address(parent_address), BASE_NODE_SIZE, 0xFF);
+    nodemgmt_erase_node_slot(parent_address, TRUE);
     
     // Delete the children (evil laugh)
     nodemgmt_delete_children_list(first_child_address, TRUE);
@@ -2366,13 +3866,19 @@ void nodemgmt_delete_children_list(uint16_t first_children_addr, BOOL data_child
         }
         
         // Delete child data block
-        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_child_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_child_addr), BASE_NODE_SIZE, 0xFF);
-        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(next_child_addr)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(next_child_addr)), BASE_NODE_SIZE, 0xFF);
+        nodemgmt_erase_node_slot(next_child_addr, TRUE);
+        nodemgmt_erase_node_slot(nodemgmt_get_incremented_address(next_child_addr), FALSE);
         
         // Set correct next address
         next_child_addr = temp_address;
     }
     
+    // Credential children deleted: we don't know their parent, so forget all the children categories
+    if (data_child == FALSE)
+    {
+        nodemgmt_reset_service_index_categories();
+    }
+    
     // Rescan node usage
     nodemgmt_scan_node_usage();
 }
@@ -2393,6 +3899,9 @@ void nodemgmt_delete_current_user_from_flash(void)
     _Static_assert(sizeof(temp_buffer) >= offsetof(parent_data_node_t, nextChildAddress) + sizeof(parent_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
     _Static_assert(sizeof(temp_buffer) >= offsetof(child_cred_node_t, nextChildAddress) + sizeof(child_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
         
+    // Changes of a deleted user don't need to be tracked
+    nodemgmt_stop_change_journal_tracking();
+    
     // Delete user profile memory
     nodemgmt_format_user_profile(nodemgmt_current_handle.currentUserId, 0, 0, 0, 0);
     
@@ -2423,7 +3932,7 @@ void nodemgmt_delete_current_user_from_flash(void)
             temp_address = parent_node_pt->nextParentAddress;
             
             // Delete parent data block
-            dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_parent_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_parent_addr), BASE_NODE_SIZE, 0xFF);
+            nodemgmt_erase_node_slot(next_parent_addr, TRUE);
             
             // Set correct next address
             next_parent_addr = temp_address;
@@ -2817,18 +4326,21 @@ RET_TYPE nodemgmt_create_generic_node(generic_node_t* g, node_type_te node_type,
     return RETURN_OK;
 }
 
-/*! \fn     nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress)
+/*! \fn     nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId, uint16_t searchStartAddress)
  *  \brief  Writes a parent node to memory (next free via handle) (in alphabetical order)
- *  \param  p               The parent node to write to memory (nextFreeParentNode)
- *  \param  type            Type of context (data or credential)
- *  \param  storedAddress   Where to store the address at which the node was stored
- *  \param  typeId          Credential / Data Type ID
+ *  \param  p                   The parent node to write to memory (nextFreeParentNode)
+ *  \param  type                Type of context (data or credential)
+ *  \param  storedAddress       Where to store the address at which the node was stored
+ *  \param  typeId              Credential / Data Type ID
+ *  \param  searchStartAddress  Address of a parent node in the same list to start the insertion point search from, or NODE_ADDR_NULL
  *  \return success status
  *  \note   Handles necessary doubly linked list management
+ *  \note   searchStartAddress is only used if it is in the service index and if its service comes before the new one, the search otherwise starts at the first parent
  */
-RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId)
+RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId, uint16_t searchStartAddress)
 {
     uint16_t first_parent_addr, last_parent_addr, potential_new_fparent, potential_new_lparent;
+    uint16_t search_start_addr;
     RET_TYPE temprettype;
     
     // Set the first parent address depending on the type
@@ -2856,14 +4368,51 @@ RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uin
     // This is particular to parent nodes...
     p->cred_parent.nextChildAddress = NODE_ADDR_NULL;
     
+    // By default, look for the insertion point from the beginning of the list
+    search_start_addr = first_parent_addr;
+    
+    // Search start hint: the service index tells us it is a parent of this list, check that the new service comes after it
+    if ((searchStartAddress != NODE_ADDR_NULL) && (searchStartAddress != first_parent_addr))
+    {
+        uint16_t list_id = (type == SERVICE_CRED_TYPE)? typeId : typeId + MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes);
+        
+        if (nodemgmt_get_service_index_entry(list_id, searchStartAddress) != 0)
+        {
+            nodemgmt_read_parent_node_data_block_from_flash(searchStartAddress, &nodemgmt_current_handle.temp_parent_node);
+            if (utils_custchar_strncmp(p->cred_parent.service, nodemgmt_current_handle.temp_parent_node.cred_parent.service, MEMBER_ARRAY_SIZE(parent_cred_node_t, service)) > 0)
+            {
+                search_start_addr = searchStartAddress;
+            }
+        }
+    }
+    
     // Call nodemgmt_create_generic_node to add a node
     if (type == SERVICE_CRED_TYPE)
     {
-        temprettype = nodemgmt_create_generic_node((generic_node_t*)p, NODE_TYPE_PARENT, first_parent_addr, &potential_new_fparent, storedAddress, &potential_new_lparent);
+        temprettype = nodemgmt_create_generic_node((generic_node_t*)p, NODE_TYPE_PARENT, search_start_addr, &potential_new_fparent, storedAddress, &potential_new_lparent);
     }
     else
     {
-        temprettype = nodemgmt_create_generic_node((generic_node_t*)p, NODE_TYPE_PARENT_DATA, first_parent_addr, &potential_new_fparent, storedAddress, &potential_new_lparent);
+        temprettype = nodemgmt_create_generic_node((generic_node_t*)p, NODE_TYPE_PARENT_DATA, search_start_addr, &potential_new_fparent, storedAddress, &potential_new_lparent);
+    }
+    
+    // Insertion point search started after the first parent: it can't have changed
+    if (search_start_addr != first_parent_addr)
+    {
+        potential_new_fparent = first_parent_addr;
+    }
+    
+    // If the return is ok, update service index
+    if (temprettype == RETURN_OK)
+    {
+        if (type == SERVICE_CRED_TYPE)
+        {
+            nodemgmt_add_to_service_index(typeId, *storedAddress, p);
+        }
+        else
+        {
+            nodemgmt_add_to_service_index(typeId + MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes), *storedAddress, p);
+        }
     }
     
     // If the return is ok & we changed the first node address
@@ -2919,6 +4468,25 @@ RET_TYPE nodemgmt_create_child_node(uint16_t pAddr, child_cred_node_t* c, uint16
     // Call nodemgmt_create_generic_node to add a node
     temprettype = nodemgmt_create_generic_node((generic_node_t*)c, NODE_TYPE_CHILD, childFirstAddress, &temp_address, storedAddress, &temp_address2);
     
+    // If the return is ok, add the new child category to the parent children categories (if already computed)
+    if (temprettype == RETURN_OK)
+    {
+        for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes); i++)
+        {
+            nodemgmt_service_index_entry_t* entry_pt = nodemgmt_get_service_index_entry(i, pAddr);
+            
+            if (entry_pt != 0)
+            {
+                uint8_t* categories_pt = &nodemgmt_current_handle.serviceIndexCategories[entry_pt - nodemgmt_current_handle.serviceIndex];
+                if ((*categories_pt & NODEMGMT_SERVICE_INDEX_CATS_KNOWN) != 0)
+                {
+                    *categories_pt |= nodemgmt_get_service_index_category_bit(categoryFromFlags(c->flags));
+                }
+                break;
+            }
+        }
+    }
+    
     // If the return is ok & we changed the first child address
     if ((temprettype == RETURN_OK) && (childFirstAddress != temp_address))
     {
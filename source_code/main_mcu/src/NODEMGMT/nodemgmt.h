@@ -71,6 +71,40 @@ typedef enum    {NODE_TYPE_PARENT = 0, NODE_TYPE_CHILD = 1, NODE_TYPE_PARENT_DAT
 #define NODEMGMT_CAT_MASK_FINAL                     0x000F
 #define NODEMGMT_CAT_MASK                           0x000F
 #define NODEMGMT_CAT_BITSHIFT                       0
+#define NODEMGMT_NB_NODES_PER_PAGE                  (BYTES_PER_PAGE/BASE_NODE_SIZE)
+#define NODEMGMT_NB_NODE_SLOTS                      ((PAGE_COUNT-PAGE_PER_SECTOR)*NODEMGMT_NB_NODES_PER_PAGE)
+#define NODEMGMT_NODE_USAGE_BITMAP_SIZE             (NODEMGMT_NB_NODE_SLOTS/32)
+#define NODEMGMT_NODE_USAGE_BITMAP_BUILT_SIZE       ((NODEMGMT_NODE_USAGE_BITMAP_SIZE+31)/32)
+#ifndef NODEMGMT_SERVICE_INDEX_SIZE
+#define NODEMGMT_SERVICE_INDEX_SIZE                 384
+#endif
+#define NODEMGMT_SERVICE_INDEX_HASH_MASK            0x3FFF
+#define NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG      0x4000
+#define NODEMGMT_SERVICE_INDEX_MULT_DOMAIN_FLAG     0x8000
+#define NODEMGMT_SERVICE_INDEX_POS_INVALID          0xFFFF
+#define NODEMGMT_SERVICE_INDEX_READ_CHUNK           32
+#define NODEMGMT_SERVICE_INDEX_CATS_NONE            0x01
+#define NODEMGMT_SERVICE_INDEX_CATS_OTHER           0x20
+#define NODEMGMT_SERVICE_INDEX_CATS_KNOWN           0x80
+#define NODEMGMT_MAX_NB_NODE_WRITES                 8
+#define NODEMGMT_CHANGE_JOURNAL_NB_PENDING          8
+#define NODEMGMT_CHANGE_JOURNAL_ENTRIES_PER_PAGE    (BYTES_PER_PAGE/sizeof(nodemgmt_change_journal_entry_t))
+#define NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE    (BYTES_PER_PAGE/sizeof(nodemgmt_change_journal_user_record_t))
+#define NODEMGMT_CHANGE_JOURNAL_NB_RECORD_PAGES     ((NB_MAX_USERS+NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE-1)/NODEMGMT_CHANGE_JOURNAL_RECORDS_PER_PAGE)
+#ifndef NODEMGMT_PAGE_HASH_PAGES_PER_LEAF
+#define NODEMGMT_PAGE_HASH_PAGES_PER_LEAF           32
+#endif
+#define NODEMGMT_PAGE_HASH_LEAVES_PER_CALL          4
+#define NODEMGMT_PAGE_HASH_NB_USED_LEAVES           ((PAGE_COUNT-PAGE_PER_SECTOR+NODEMGMT_PAGE_HASH_PAGES_PER_LEAF-1)/NODEMGMT_PAGE_HASH_PAGES_PER_LEAF)
+#if NODEMGMT_PAGE_HASH_NB_USED_LEAVES <= 64
+#define NODEMGMT_PAGE_HASH_NB_LEAVES                64
+#elif NODEMGMT_PAGE_HASH_NB_USED_LEAVES <= 128
+#define NODEMGMT_PAGE_HASH_NB_LEAVES                128
+#elif NODEMGMT_PAGE_HASH_NB_USED_LEAVES <= 256
+#define NODEMGMT_PAGE_HASH_NB_LEAVES                256
+#else
+#error "Too many page hash tree leaves, increase NODEMGMT_PAGE_HASH_PAGES_PER_LEAF"
+#endif
 
 /* User security settings flags */
 #define USER_SEC_FLG_LOGIN_CONF             0x01
@@ -331,6 +365,37 @@ typedef struct
     cust_char_t category_strings[4][33];
 } nodemgmt_user_category_strings_t;
 
+// Service index entry: parent address and its service name hash, 4B per parent
+typedef struct
+{
+    uint16_t address;                       // Parent node address
+    uint16_t hash;                          // Service name hash (service part only, NODEMGMT_SERVICE_INDEX_MULT_DOMAIN_FLAG set for multiple domain parents, NODEMGMT_SERVICE_INDEX_NEW_LETTER_FLAG set when the first letter differs from the previous entry one)
+} nodemgmt_service_index_entry_t;
+
+// Change journal entry: node address written by a given user and the change numbers at that time
+typedef struct
+{
+    uint16_t user_id;                       // User ID, 0xFFFF for an empty entry
+    uint16_t node_address;                  // Written / erased node address
+    uint32_t cred_change_number;            // Credential change number when the node was written
+    uint32_t data_change_number;            // Data change number when the node was written
+} nodemgmt_change_journal_entry_t;
+
+// Change journal user record, all 0xFF when the user changes aren't tracked
+typedef struct
+{
+    uint32_t last_missing_cred_change_number;   // Latest credential change number for which the journal may be missing entries of that user
+    uint32_t last_missing_data_change_number;   // Latest data change number for which the journal may be missing entries of that user
+} nodemgmt_change_journal_user_record_t;
+
+// Node write request, for batched node writes
+typedef struct
+{
+    uint16_t address;                       // Node address
+    uint16_t node_size;                     // sizeof(parent_node_t) or sizeof(child_node_t)
+    void* node_pt;                          // Pointer to the parent or child node
+} nodemgmt_node_write_request_t;
+
 // Node management handle
 typedef struct
 {
@@ -350,6 +415,18 @@ typedef struct
     uint16_t currentCategoryFlags;          // Current category flags
     uint16_t lastCredParentNodes[10];       // The address of the users last cred parent node (read from flash. eg cache)
     uint16_t lastDataParentNodes[7];        // The addresses of the users last data parent nodes (read from flash. eg cache)
+    uint32_t nodeUsageBitmap[NODEMGMT_NODE_USAGE_BITMAP_SIZE];  // One bit per node slot after sector 0, set when the slot is used (built on demand, eg cache)
+    uint32_t nodeUsageBitmapBuilt[NODEMGMT_NODE_USAGE_BITMAP_BUILT_SIZE];    // One bit per node usage bitmap word, set once that word was read from flash
+    BOOL serviceIndexValid;                 // Boolean to indicate if the service index below can be used
+    uint16_t serviceIndexCounts[10+7];      // Number of service index entries for each cred parent list, then for each data parent list
+    nodemgmt_service_index_entry_t serviceIndex[NODEMGMT_SERVICE_INDEX_SIZE];  // Parent addresses & service hashes, list after list, in the parent lists order (built at login, eg cache)
+    uint8_t serviceIndexCategories[NODEMGMT_SERVICE_INDEX_SIZE];    // Categories found in the children of each service index entry, 0 when not computed yet (computed on demand, eg cache)
+    BOOL changeJournalLoggingEnabled;       // Boolean to indicate if the current user changes should be logged (cleared when deleting the user)
+    uint16_t changeJournalWriteSlot;        // Next change journal slot to be written (found at login)
+    uint16_t changeJournalNbPending;        // Number of change journal entries not yet written to flash
+    nodemgmt_change_journal_entry_t changeJournalPending[NODEMGMT_CHANGE_JOURNAL_NB_PENDING];   // Change journal entries not yet written to flash
+    uint32_t pageHashLeaves[NODEMGMT_PAGE_HASH_NB_LEAVES];      // Page hash tree leaves (computed on demand, eg cache), internal nodes are computed from them
+    uint32_t pageHashLeavesValid[NODEMGMT_PAGE_HASH_NB_LEAVES/32];  // One bit per page hash tree leaf, set when its hash is up to date
 } nodemgmtHandle_t;
 
 /* Inlines */
@@ -425,6 +502,12 @@ static inline node_type_te nodeTypeFromFlags(uint16_t flags)
 }
 
 /* Prototypes */
+RET_TYPE nodemgmt_get_changed_node_addresses(uint32_t cred_change_number, uint32_t data_change_number, uint16_t nb_to_skip, uint16_t* addresses, uint16_t max_nb_addresses, uint16_t* nb_addresses, BOOL* more_addresses);
+uint16_t nodemgmt_get_next_service_index_candidate(BOOL data_parent, uint16_t type_id, uint16_t service_hash, BOOL include_mult_domain, uint16_t* iterator);
+RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId, uint16_t searchStartAddress);
+uint16_t nodemgmt_get_service_index_entry_for_cur_category(uint16_t credential_type_id, uint16_t position);
+BOOL nodemgmt_is_service_index_entry_new_letter(uint16_t credential_type_id, uint16_t position);
+cust_char_t nodemgmt_get_service_index_entry_first_char(uint16_t credential_type_id, uint16_t position);
 RET_TYPE nodemgmt_create_generic_node(generic_node_t* g, node_type_te node_type, uint16_t firstNodeAddress, uint16_t* newFirstNodeAddress, uint16_t* storedAddress, uint16_t* newLastNodeAddress);
 void nodemgmt_get_prev_favorite_and_category_index(int16_t category_index, int16_t favorite_index, int16_t* new_cat_index, int16_t* new_fav_index, BOOL navigate_across_categories);
 void nodemgmt_get_next_favorite_and_category_index(int16_t category_index, int16_t favorite_index, int16_t* new_cat_index, int16_t* new_fav_index, BOOL navigate_across_categories);
@@ -443,13 +526,14 @@ uint16_t nodemgmt_get_encrypted_data_from_data_node(uint16_t data_child_address,
 void nodemgmt_fetch_favorites_filtered_by_cat_sorted(favorite_addr_t* favorite_array, BOOL last_used_sort, uint16_t* nb_favs);
 uint16_t nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_parent_addr, uint16_t credential_type_id);
 uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_parent_addr, uint16_t credential_type_id);
-RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId);
 void nodemgmt_read_cred_child_node(uint16_t address, child_cred_node_t* child_node, BOOL overwrite_if_pted_pwd_totp);
 RET_TYPE nodemgmt_store_bluetooth_bonding_information(nodemgmt_bluetooth_bonding_information_t* bonding_information);
 uint16_t nodemgmt_check_for_logins_with_category_in_parent_node(uint16_t start_child_addr, uint16_t category_flags);
 void nodemgmt_read_favorite(uint16_t categoryId, uint16_t favId, uint16_t* parentAddress, uint16_t* childAddress);
 void nodemgmt_read_favorite_for_current_category(uint16_t favId, uint16_t* parentAddress, uint16_t* childAddress);
+page_hash_ret_te nodemgmt_get_page_hash_tree_hashes(uint16_t first_tree_node, uint16_t nb_tree_nodes, uint32_t* hashes);
 void nodemgmt_write_child_node_block_to_flash(uint16_t address, child_node_t* child_node, BOOL write_category);
+void nodemgmt_write_node_blocks_to_flash(nodemgmt_node_write_request_t* write_requests, uint16_t nb_write_requests);
 void nodemgmt_set_favorite(uint16_t categoryId, uint16_t favId, uint16_t parentAddress, uint16_t childAddress);
 void nodemgmt_get_bluetooth_bonding_info_starting_offset(uint16_t uid, uint16_t *page, uint16_t *pageOffset);
 RET_TYPE nodemgmt_read_parent_node_permissive(uint16_t address, parent_node_t* parent_node, BOOL data_clean);
@@ -479,7 +563,10 @@ void nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt)
 void nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt);
 void nodemgmt_get_category_string(uint16_t category_id, cust_char_t* string_pt);
 void nodemgmt_set_category_string(uint16_t category_id, cust_char_t* string_pt);
+uint16_t nodemgmt_get_service_hash(cust_char_t* service, uint16_t max_length);
 uint16_t nodemgmt_construct_date(uint16_t year, uint16_t month, uint16_t day);
+uint16_t nodemgmt_get_service_index_position(uint16_t credential_type_id, uint16_t parent_addr);
+uint16_t nodemgmt_get_service_index_nb_entries(uint16_t credential_type_id);
 uint16_t nodemgmt_get_starting_parent_addr(uint16_t credential_type_id);
 uint16_t nodemgmt_get_sec_preference_for_user_id(uint16_t userIdNum);
 uint16_t nodemgmt_get_user_language_for_user_id(uint16_t userIdNum);
@@ -508,10 +595,12 @@ void nodemgmt_delete_current_user_from_flash(void);
 uint16_t nodemgmt_get_current_category_flags(void);
 void nodemgmt_store_user_layout(uint16_t layoutId);
 void nodemgmt_trigger_db_ext_changed_actions(void);
+void nodemgmt_invalidate_service_index(void);
 uint16_t nodemgmt_get_user_sec_preferences(void);
 uint32_t nodemgmt_get_cred_change_number(void);
 uint32_t nodemgmt_get_data_change_number(void);
 void nodemgmt_scan_for_last_parent_nodes(void);
+BOOL nodemgmt_is_service_index_valid(void);
 void nodemgmt_set_current_date(uint16_t date);
 uint16_t nodemgmt_get_current_category(void);
 uint16_t nodemgmt_get_user_ble_layout(void);
@@ -0,0 +1,171 @@
+/*
+ * This file is part of the Mooltipass Project (https://github.com/mooltipass).
+ * Copyright (c) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!  \file     oled_raster.c
+*    \brief    4bpp frame buffer raster kernels, shared by the OLED drivers
+*    Created:  17/10/2026
+*    Author:   agent
+*    Note:     newlib nano memcpy / memset work one byte at a time. The Cortex-M0+ doesn't do unaligned
+*              accesses, so the kernels below align the destination and then work on 32 bits words.
+*/
+#include "oled_raster.h"
+
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+    #error "Raster kernels expect a little endian platform"
+#endif
+
+/* Word type allowed to alias our byte buffers */
+typedef uint32_t __attribute__((__may_alias__)) oled_raster_word_t;
+
+
+/*! \fn     oled_raster_fill(uint8_t* dst, uint8_t pattern, uint16_t nb_bytes)
+*   \brief  Fill a frame buffer area with a given byte
+*   \param  dst         Where to fill
+*   \param  pattern     Byte to fill with (2 pixels)
+*   \param  nb_bytes    Number of bytes to fill
+*/
+void oled_raster_fill(uint8_t* dst, uint8_t pattern, uint16_t nb_bytes)
+{
+    uint32_t pattern_word = pattern * 0x01010101UL;
+
+    /* Align destination */
+    while ((nb_bytes != 0) && (((uintptr_t)dst & 0x03) != 0))
+    {
+        *dst++ = pattern;
+        nb_bytes--;
+    }
+
+    /* 16 pixels per loop, 8 per word */
+    oled_raster_word_t* dst_word = (oled_raster_word_t*)(void*)dst;
+    while (nb_bytes >= 8)
+    {
+        dst_word[0] = pattern_word;
+        dst_word[1] = pattern_word;
+        dst_word += 2;
+        nb_bytes -= 8;
+    }
+    if (nb_bytes >= 4)
+    {
+        *dst_word++ = pattern_word;
+        nb_bytes -= 4;
+    }
+
+    /* Remaining bytes */
+    dst = (uint8_t*)dst_word;
+    while (nb_bytes-- != 0)
+    {
+        *dst++ = pattern;
+    }
+}
+
+/*! \fn     oled_raster_copy(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes)
+*   \brief  Copy pixels when source and destination are 2 pixels aligned
+*   \param  dst         Destination
+*   \param  src         Source
+*   \param  nb_bytes    Number of bytes to copy
+*/
+void oled_raster_copy(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes)
+{
+    /* Align destination */
+    while ((nb_bytes != 0) && (((uintptr_t)dst & 0x03) != 0))
+    {
+        *dst++ = *src++;
+        nb_bytes--;
+    }
+
+    oled_raster_word_t* dst_word = (oled_raster_word_t*)(void*)dst;
+    if (((uintptr_t)src & 0x03) == 0)
+    {
+        /* Both aligned: word copies */
+        const oled_raster_word_t* src_word = (const oled_raster_word_t*)(const void*)src;
+        while (nb_bytes >= 8)
+        {
+            dst_word[0] = src_word[0];
+            dst_word[1] = src_word[1];
+            dst_word += 2;
+            src_word += 2;
+            nb_bytes -= 8;
+        }
+        src = (const uint8_t*)src_word;
+    }
+    else
+    {
+        /* Unaligned source: assemble words from bytes, still one store per 8 pixels */
+        while (nb_bytes >= 4)
+        {
+            *dst_word++ = (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+            src += 4;
+            nb_bytes -= 4;
+        }
+    }
+
+    /* Remaining bytes */
+    dst = (uint8_t*)dst_word;
+    while (nb_bytes-- != 0)
+    {
+        *dst++ = *src++;
+    }
+}
+
+/*! \fn     oled_raster_copy_shifted(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes, uint8_t prev_byte)
+*   \brief  Copy pixels shifted by one pixel to the right: dst[i] = (src[i-1] << 4) | (src[i] >> 4)
+*   \param  dst         Destination
+*   \param  src         Source
+*   \param  nb_bytes    Number of bytes to write
+*   \param  prev_byte   Byte to use as src[-1]
+*   \return Last source byte read (prev_byte if nb_bytes is 0), to continue the shift
+*/
+uint8_t oled_raster_copy_shifted(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes, uint8_t prev_byte)
+{
+    uint32_t prev = prev_byte;
+
+    /* Align destination */
+    while ((nb_bytes != 0) && (((uintptr_t)dst & 0x03) != 0))
+    {
+        *dst++ = (uint8_t)((prev << 4) | (*src >> 4));
+        prev = *src++;
+        nb_bytes--;
+    }
+
+    /* 8 pixels per loop: shift the big endian view of 4 source bytes by one nibble */
+    oled_raster_word_t* dst_word = (oled_raster_word_t*)(void*)dst;
+    while (nb_bytes >= 4)
+    {
+        uint32_t src_be;
+        if (((uintptr_t)src & 0x03) == 0)
+        {
+            src_be = __builtin_bswap32(*(const oled_raster_word_t*)(const void*)src);
+        }
+        else
+        {
+            src_be = ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | (uint32_t)src[3];
+        }
+        *dst_word++ = __builtin_bswap32((prev << 28) | (src_be >> 4));
+        prev = src_be & 0xFF;
+        src += 4;
+        nb_bytes -= 4;
+    }
+
+    /* Remaining bytes */
+    dst = (uint8_t*)dst_word;
+    while (nb_bytes-- != 0)
+    {
+        *dst++ = (uint8_t)((prev << 4) | (*src >> 4));
+        prev = *src++;
+    }
+
+    return (uint8_t)prev;
+}
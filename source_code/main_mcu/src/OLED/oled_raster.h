@@ -0,0 +1,34 @@
+/*
+ * This file is part of the Mooltipass Project (https://github.com/mooltipass).
+ * Copyright (c) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!  \file     oled_raster.h
+*    \brief    4bpp frame buffer raster kernels, shared by the OLED drivers
+*    Created:  17/10/2026
+*    Author:   agent
+*/
+
+
+#ifndef OLED_RASTER_H_
+#define OLED_RASTER_H_
+
+#include <stdint.h>
+
+/* Prototypes */
+uint8_t oled_raster_copy_shifted(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes, uint8_t prev_byte);
+void oled_raster_copy(uint8_t* dst, const uint8_t* src, uint16_t nb_bytes);
+void oled_raster_fill(uint8_t* dst, uint8_t pattern, uint16_t nb_bytes);
+
+#endif /* OLED_RASTER_H_ */
@@ -98,11 +98,13 @@
     
     #ifdef OLED_INTERNAL_FRAME_BUFFER
     #define oled_check_for_flush_and_terminate                        sh1122_check_for_flush_and_terminate
+    #define oled_wait_for_frame_buffer_availability                   sh1122_wait_for_frame_buffer_availability
     #define oled_flush_frame_buffer_y_window                          sh1122_flush_frame_buffer_y_window
     #define oled_flush_frame_buffer_window                            sh1122_flush_frame_buffer_window
     #define oled_clear_y_frame_buffer                                 sh1122_clear_y_frame_buffer
     #define oled_flush_frame_buffer                                   sh1122_flush_frame_buffer
     #define oled_clear_frame_buffer                                   sh1122_clear_frame_buffer
+    #define oled_set_frame_buffer_dirty                               sh1122_set_frame_buffer_dirty
     #endif
     
     #ifdef OLED_PRINTF_ENABLED
@@ -177,6 +179,7 @@
     
     #ifdef OLED_INTERNAL_FRAME_BUFFER
     #define oled_check_for_flush_and_terminate                        ssd1363_check_for_flush_and_terminate
+    #define oled_wait_for_frame_buffer_availability                   ssd1363_check_for_flush_and_terminate
     #define oled_flush_frame_buffer_window                            ssd1363_flush_frame_buffer_window
     #define oled_flush_frame_buffer                                   ssd1363_flush_frame_buffer
     #define oled_clear_frame_buffer                                   ssd1363_clear_frame_buffer
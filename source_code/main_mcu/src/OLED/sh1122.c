@@ -28,6 +28,7 @@
 #include "custom_bitstream.h"
 #include "driver_sercom.h"
 #include "driver_timer.h"
+#include "oled_raster.h"
 #include "custom_fs.h"
 #include "sh1122.h"
 #include "dma.h"
@@ -37,6 +38,32 @@
 #elif !defined(BOOTLOADER)
 static void emu_oled_flush(void) {}
 #endif
+#if SH1122_GLYPH_CACHE_NB_FONTS > 0
+/* Glyph cache entry: glyph index & header for a given unicode point */
+typedef struct
+{
+    cust_char_t ch;                                     // Unicode point, 0xFFFF for an empty entry
+    uint16_t gind;                                      // Glyph index, 0xFFFF if the font can't display this char
+    font_glyph_t glyph;                                 // Glyph header: size, offsets and data offset
+} sh1122_cached_glyph_t;
+/* Glyph cache font */
+typedef struct
+{
+    custom_fs_address_t font_address;                   // Font address, 0 for an empty slot
+    uint32_t last_used_stamp;                           // For LRU eviction
+    font_header_t font_header;                          // Font header
+    unicode_interval_desc_t unicode_inters[15];         // Unicode interval descriptors
+    sh1122_cached_glyph_t glyphs[SH1122_GLYPH_CACHE_NB_GLYPHS];
+} sh1122_cached_font_t;
+/* Glyph cache fonts */
+sh1122_cached_font_t sh1122_glyph_cache_fonts[SH1122_GLYPH_CACHE_NB_FONTS];
+/* Glyph cache font load counter, used for LRU eviction */
+uint32_t sh1122_glyph_cache_stamp = 0;
+/* CRC of the bundle the cached fonts come from */
+uint32_t sh1122_glyph_cache_bundle_crc = 0;
+#endif
+/* Glyph cache statistics */
+sh1122_glyph_cache_stats_t sh1122_glyph_cache_stats;
 
 /* SH1122 initialization sequence */
 static const uint8_t sh1122_init_sequence[] = 
@@ -106,6 +133,10 @@ static const uint8_t sh1122_init_sequence_inverted[] =
 */
 void sh1122_write_single_command(oled_descriptor_t* oled_descriptor, uint8_t reg)
 {
+    #ifdef OLED_DOUBLE_FRAME_BUFFER
+    /* Drawing doesn't wait for flushes anymore: don't interfere with an ongoing one */
+    sh1122_check_for_flush_and_terminate(oled_descriptor);
+    #endif
     PORT->Group[oled_descriptor->cs_pin_group].OUTCLR.reg = oled_descriptor->cs_pin_mask;
     PORT->Group[oled_descriptor->cd_pin_group].OUTCLR.reg = oled_descriptor->cd_pin_mask;
     sercom_spi_send_single_byte(oled_descriptor->sercom_pt, reg);
@@ -119,6 +150,10 @@ void sh1122_write_single_command(oled_descriptor_t* oled_descriptor, uint8_t reg
 */
 void sh1122_write_single_data(oled_descriptor_t* oled_descriptor, uint8_t data)
 {
+    #ifdef OLED_DOUBLE_FRAME_BUFFER
+    /* Drawing doesn't wait for flushes anymore: don't interfere with an ongoing one */
+    sh1122_check_for_flush_and_terminate(oled_descriptor);
+    #endif
     PORT->Group[oled_descriptor->cs_pin_group].OUTCLR.reg = oled_descriptor->cs_pin_mask;
     PORT->Group[oled_descriptor->cd_pin_group].OUTSET.reg = oled_descriptor->cd_pin_mask;
     sercom_spi_send_single_byte(oled_descriptor->sercom_pt, data);
@@ -132,6 +167,10 @@ void sh1122_write_single_data(oled_descriptor_t* oled_descriptor, uint8_t data)
 */
 void sh1122_write_single_word(oled_descriptor_t* oled_descriptor, uint16_t data)
 {
+    #ifdef OLED_DOUBLE_FRAME_BUFFER
+    /* Drawing doesn't wait for flushes anymore: don't interfere with an ongoing one */
+    sh1122_check_for_flush_and_terminate(oled_descriptor);
+    #endif
     PORT->Group[oled_descriptor->cs_pin_group].OUTCLR.reg = oled_descriptor->cs_pin_mask;
     PORT->Group[oled_descriptor->cd_pin_group].OUTSET.reg = oled_descriptor->cd_pin_mask;
     sercom_spi_send_single_byte(oled_descriptor->sercom_pt, (uint8_t)(data>>8));
@@ -145,8 +184,17 @@ void sh1122_write_single_word(oled_descriptor_t* oled_descriptor, uint16_t data)
 */
 void sh1122_start_data_sending(oled_descriptor_t* oled_descriptor)
 {
+    #ifdef OLED_DOUBLE_FRAME_BUFFER
+    /* Drawing doesn't wait for flushes anymore: don't interfere with an ongoing one */
+    sh1122_check_for_flush_and_terminate(oled_descriptor);
+    #endif
     PORT->Group[oled_descriptor->cs_pin_group].OUTCLR.reg = oled_descriptor->cs_pin_mask;
     PORT->Group[oled_descriptor->cd_pin_group].OUTSET.reg = oled_descriptor->cd_pin_mask;    
+    
+    #ifdef OLED_INTERNAL_FRAME_BUFFER
+    /* Screen memory may not match our frame buffer anymore */
+    oled_descriptor->frame_buffer_full_flush_needed = TRUE;
+    #endif
 }
 
 /*! \fn     sh1122_stop_data_sending(oled_descriptor_t* oled_descriptor)
@@ -524,14 +572,87 @@ void sh1122_clear_current_screen(oled_descriptor_t* oled_descriptor)
 }
 
 #ifdef OLED_INTERNAL_FRAME_BUFFER
+/*! \fn     sh1122_mark_frame_buffer_dirty(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, int16_t width, int16_t height)
+*   \brief  Add an area to the frame buffer dirty area, sent by the next frame buffer flush
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*   \param  x                   Area X
+*   \param  y                   Area Y
+*   \param  width               Area width
+*   \param  height              Area height
+*/
+static void sh1122_mark_frame_buffer_dirty(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, int16_t width, int16_t height)
+{
+    /* Clip to the screen */
+    if (x < 0)
+    {
+        width += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        height += y;
+        y = 0;
+    }
+    if (x + width > SH1122_OLED_WIDTH)
+    {
+        width = SH1122_OLED_WIDTH - x;
+    }
+    if (y + height > SH1122_OLED_HEIGHT)
+    {
+        height = SH1122_OLED_HEIGHT - y;
+    }
+    if ((width <= 0) || (height <= 0))
+    {
+        return;
+    }
+    
+    /* Union with the current dirty area */
+    if (oled_descriptor->dirty_y_start >= oled_descriptor->dirty_y_end)
+    {
+        oled_descriptor->dirty_x_start = x;
+        oled_descriptor->dirty_x_end = x + width;
+        oled_descriptor->dirty_y_start = y;
+        oled_descriptor->dirty_y_end = y + height;
+    }
+    else
+    {
+        if (x < oled_descriptor->dirty_x_start)
+        {
+            oled_descriptor->dirty_x_start = x;
+        }
+        if (x + width > oled_descriptor->dirty_x_end)
+        {
+            oled_descriptor->dirty_x_end = x + width;
+        }
+        if (y < oled_descriptor->dirty_y_start)
+        {
+            oled_descriptor->dirty_y_start = y;
+        }
+        if (y + height > oled_descriptor->dirty_y_end)
+        {
+            oled_descriptor->dirty_y_end = y + height;
+        }
+    }
+}
+
+/*! \fn     sh1122_set_frame_buffer_dirty(oled_descriptor_t* oled_descriptor)
+*   \brief  Mark the whole frame buffer as dirty, to be called after writing to it directly
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*/
+void sh1122_set_frame_buffer_dirty(oled_descriptor_t* oled_descriptor)
+{
+    sh1122_mark_frame_buffer_dirty(oled_descriptor, 0, 0, SH1122_OLED_WIDTH, SH1122_OLED_HEIGHT);
+}
+
 /*! \fn     sh1122_clear_frame_buffer(oled_descriptor_t* oled_descriptor)
 *   \brief  Clear frame buffer
 *   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
 */
 void sh1122_clear_frame_buffer(oled_descriptor_t* oled_descriptor)
 {
-    sh1122_check_for_flush_and_terminate(oled_descriptor);
-    memset((void*)oled_descriptor->frame_buffer, 0x00, sizeof(oled_descriptor->frame_buffer));
+    sh1122_wait_for_frame_buffer_availability(oled_descriptor);
+    oled_raster_fill(&oled_descriptor->frame_buffer[0][0], 0x00, sizeof(oled_descriptor->frame_buffer));
+    sh1122_mark_frame_buffer_dirty(oled_descriptor, 0, 0, SH1122_OLED_WIDTH, SH1122_OLED_HEIGHT);
 }
 
 /*! \fn     sh1122_clear_y_frame_buffer(oled_descriptor_t* oled_descriptor)
@@ -547,8 +668,23 @@ void sh1122_clear_y_frame_buffer(oled_descriptor_t* oled_descriptor, uint16_t ys
         return;
     }
     
+    sh1122_wait_for_frame_buffer_availability(oled_descriptor);
+    oled_raster_fill(&oled_descriptor->frame_buffer[ystart][0], 0x00, (yend-ystart)*SH1122_OLED_WIDTH/2);
+    sh1122_mark_frame_buffer_dirty(oled_descriptor, 0, ystart, SH1122_OLED_WIDTH, yend-ystart);
+}
+
+/*! \fn     sh1122_wait_for_frame_buffer_availability(oled_descriptor_t* oled_descriptor)
+*   \brief  Wait until the frame buffer can be drawn into
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*   \note   Flushes are sent from a frame buffer copy when OLED_DOUBLE_FRAME_BUFFER is defined, in which case there's no need to wait
+*/
+void sh1122_wait_for_frame_buffer_availability(oled_descriptor_t* oled_descriptor)
+{
+    #ifndef OLED_DOUBLE_FRAME_BUFFER
     sh1122_check_for_flush_and_terminate(oled_descriptor);
-    memset((void*)&oled_descriptor->frame_buffer[ystart][0], 0x00, (yend-ystart)*SH1122_OLED_WIDTH/2);
+    #else
+    (void)oled_descriptor;
+    #endif
 }
 
 /*! \fn     sh1122_check_for_flush_and_terminate(oled_descriptor_t* oled_descriptor)
@@ -585,6 +721,7 @@ void sh1122_check_for_flush_and_terminate(oled_descriptor_t* oled_descriptor)
 */
 void sh1122_flush_frame_buffer_window(oled_descriptor_t* oled_descriptor, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
 {
+    BOOL full_flush_needed = oled_descriptor->frame_buffer_full_flush_needed;
     x = ((x)/2)*2;
     width = ((width+1)/2)*2;
     
@@ -611,6 +748,9 @@ void sh1122_flush_frame_buffer_window(oled_descriptor_t* oled_descriptor, uint16
     {
         sh1122_display_horizontal_pixel_line(oled_descriptor, x, i, width, &oled_descriptor->frame_buffer[i][x/2], FALSE);
     }
+    
+    /* Sending our frame buffer doesn't make the screen differ from it */
+    oled_descriptor->frame_buffer_full_flush_needed = full_flush_needed;
 }
 
 /*! \fn     sh1122_flush_frame_buffer_y_window(oled_descriptor_t* oled_descriptor, uint16_t ystart, uint16_t yend)
@@ -621,6 +761,8 @@ void sh1122_flush_frame_buffer_window(oled_descriptor_t* oled_descriptor, uint16
 */
 void sh1122_flush_frame_buffer_y_window(oled_descriptor_t* oled_descriptor, uint16_t ystart, uint16_t yend)
 {
+    BOOL full_flush_needed = oled_descriptor->frame_buffer_full_flush_needed;
+    
     /* Sanity checks */
     if (ystart >= SH1122_OLED_HEIGHT)
     {
@@ -639,9 +781,17 @@ void sh1122_flush_frame_buffer_y_window(oled_descriptor_t* oled_descriptor, uint
     sh1122_start_data_sending(oled_descriptor);
     
     /* Send buffer! */
-    #ifdef OLED_DMA_TRANSFER        
+    #if defined(OLED_DOUBLE_FRAME_BUFFER)
+        /* Send a copy so we can keep on drawing during the transfer */
+        oled_raster_copy(&oled_descriptor->dma_frame_buffer[ystart][0], &oled_descriptor->frame_buffer[ystart][0], (yend-ystart)*SH1122_OLED_WIDTH/2);
+        dma_oled_init_transfer(oled_descriptor->sercom_pt, (void*)&oled_descriptor->dma_frame_buffer[ystart][0], (yend-ystart)*SH1122_OLED_WIDTH/2, oled_descriptor->dma_trigger_id);
+        oled_descriptor->frame_buffer_flush_in_progress = TRUE;
+    #elif defined(OLED_DMA_TRANSFER)
         dma_oled_init_transfer(oled_descriptor->sercom_pt, (void*)&oled_descriptor->frame_buffer[ystart][0], (yend-ystart)*SH1122_OLED_WIDTH/2, oled_descriptor->dma_trigger_id);
         oled_descriptor->frame_buffer_flush_in_progress = TRUE;
+    #elif defined(EMULATOR_BUILD)
+        /* Hand the whole region to the emulated display at once */
+        emu_oled_data(&oled_descriptor->frame_buffer[ystart][0], (yend-ystart)*SH1122_OLED_WIDTH/2);
     #else
         for (uint32_t y = ystart; y < yend; y++) 
         {
@@ -650,6 +800,9 @@ void sh1122_flush_frame_buffer_y_window(oled_descriptor_t* oled_descriptor, uint
             }
         }
     #endif
+    
+    /* Sending our frame buffer doesn't make the screen differ from it */
+    oled_descriptor->frame_buffer_full_flush_needed = full_flush_needed;
 }
 
 /*! \fn     sh1122_flush_frame_buffer(oled_descriptor_t* oled_descriptor)
@@ -661,7 +814,23 @@ void sh1122_flush_frame_buffer(oled_descriptor_t* oled_descriptor)
     /* Wait for a possible ongoing previous flush */
     sh1122_check_for_flush_and_terminate(oled_descriptor);
     
-    if (oled_descriptor->loaded_transition == OLED_TRANS_NONE)
+    if ((oled_descriptor->loaded_transition == OLED_TRANS_NONE) && (oled_descriptor->frame_buffer_full_flush_needed == FALSE))
+    {
+        /* Screen matches our frame buffer outside of the dirty area: only send that area */
+        if (oled_descriptor->dirty_y_start < oled_descriptor->dirty_y_end)
+        {
+            /* Narrow area within the display window: send its lines one by one, otherwise send the full lines in one go */
+            if (((oled_descriptor->dirty_x_end - oled_descriptor->dirty_x_start) <= SH1122_OLED_WIDTH/2) && (oled_descriptor->dirty_y_start >= oled_descriptor->min_disp_y) && (oled_descriptor->dirty_y_end <= oled_descriptor->max_disp_y))
+            {
+                sh1122_flush_frame_buffer_window(oled_descriptor, oled_descriptor->dirty_x_start, oled_descriptor->dirty_y_start, oled_descriptor->dirty_x_end - oled_descriptor->dirty_x_start, oled_descriptor->dirty_y_end - oled_descriptor->dirty_y_start);
+            }
+            else
+            {
+                sh1122_flush_frame_buffer_y_window(oled_descriptor, oled_descriptor->dirty_y_start, oled_descriptor->dirty_y_end);
+            }
+        }
+    }
+    else if (oled_descriptor->loaded_transition == OLED_TRANS_NONE)
     {        
         /* Set pixel write window */
         sh1122_set_row_address(oled_descriptor, 0);
@@ -671,9 +840,17 @@ void sh1122_flush_frame_buffer(oled_descriptor_t* oled_descriptor)
         sh1122_start_data_sending(oled_descriptor);
         
         /* Send buffer! */
-        #ifdef OLED_DMA_TRANSFER        
+        #if defined(OLED_DOUBLE_FRAME_BUFFER)
+            /* Send a copy so we can keep on drawing during the transfer */
+            oled_raster_copy(&oled_descriptor->dma_frame_buffer[0][0], &oled_descriptor->frame_buffer[0][0], sizeof(oled_descriptor->frame_buffer));
+            dma_oled_init_transfer(oled_descriptor->sercom_pt, (void*)&oled_descriptor->dma_frame_buffer[0][0], sizeof(oled_descriptor->dma_frame_buffer), oled_descriptor->dma_trigger_id);
+            oled_descriptor->frame_buffer_flush_in_progress = TRUE;
+        #elif defined(OLED_DMA_TRANSFER)
             dma_oled_init_transfer(oled_descriptor->sercom_pt, (void*)&oled_descriptor->frame_buffer[0][0], sizeof(oled_descriptor->frame_buffer), oled_descriptor->dma_trigger_id);
             oled_descriptor->frame_buffer_flush_in_progress = TRUE;
+        #elif defined(EMULATOR_BUILD)
+            /* Hand the whole frame to the emulated display at once */
+            emu_oled_data(&oled_descriptor->frame_buffer[0][0], sizeof(oled_descriptor->frame_buffer));
         #else
             for (uint32_t y = 0; y < SH1122_OLED_HEIGHT; y++) 
             {
@@ -820,21 +997,90 @@ void sh1122_flush_frame_buffer(oled_descriptor_t* oled_descriptor)
         }
     }
     
-    /* Reset transition */
+    /* Reset transition, screen now matches our frame buffer */
     oled_descriptor->loaded_transition = OLED_TRANS_NONE;
+    oled_descriptor->frame_buffer_full_flush_needed = FALSE;
+    oled_descriptor->dirty_y_start = 0;
+    oled_descriptor->dirty_y_end = 0;
     emu_oled_flush();
 }
 #endif
 
+/*! \fn     sh1122_get_glyph_cache_stats(sh1122_glyph_cache_stats_t* stats)
+*   \brief  Get the glyph cache hit / miss counters
+*   \param  stats   Where to store the counters
+*/
+void sh1122_get_glyph_cache_stats(sh1122_glyph_cache_stats_t* stats)
+{
+    *stats = sh1122_glyph_cache_stats;
+}
+
+/*! \fn     sh1122_load_font(oled_descriptor_t* oled_descriptor, custom_fs_address_t font_address)
+*   \brief  Load a font header & its unicode intervals, from the glyph cache when possible
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*   \param  font_address        Font address
+*   \note   A font loaded again keeps the glyphs cached the previous times it was used
+*/
+static void sh1122_load_font(oled_descriptor_t* oled_descriptor, custom_fs_address_t font_address)
+{
+    oled_descriptor->currentFontAddress = font_address;
+
+#if SH1122_GLYPH_CACHE_NB_FONTS > 0
+    sh1122_cached_font_t* font_pt = 0;
+    sh1122_cached_font_t* lru_font_pt = &sh1122_glyph_cache_fonts[0];
+    
+    /* New bundle (update, reindex...): drop everything */
+    uint32_t bundle_crc = custom_fs_get_buffered_flash_header_pt()->crc32;
+    if (bundle_crc != sh1122_glyph_cache_bundle_crc)
+    {
+        for (uint16_t i = 0; i < SH1122_GLYPH_CACHE_NB_FONTS; i++)
+        {
+            sh1122_glyph_cache_fonts[i].font_address = 0;
+        }
+        sh1122_glyph_cache_bundle_crc = bundle_crc;
+    }
+    
+    /* Look for this font, or for the least recently used slot */
+    for (uint16_t i = 0; i < SH1122_GLYPH_CACHE_NB_FONTS; i++)
+    {
+        if (sh1122_glyph_cache_fonts[i].font_address == font_address)
+        {
+            font_pt = &sh1122_glyph_cache_fonts[i];
+            break;
+        }
+        if (sh1122_glyph_cache_fonts[i].last_used_stamp < lru_font_pt->last_used_stamp)
+        {
+            lru_font_pt = &sh1122_glyph_cache_fonts[i];
+        }
+    }
+    
+    /* Not cached: read header & intervals, glyphs are then cached as they are used */
+    if (font_pt == 0)
+    {
+        font_pt = lru_font_pt;
+        custom_fs_read_from_flash((uint8_t*)&font_pt->font_header, font_address, sizeof(font_pt->font_header));
+        custom_fs_read_from_flash((uint8_t*)&font_pt->unicode_inters, font_address + sizeof(font_pt->font_header), sizeof(font_pt->unicode_inters));
+        memset(font_pt->glyphs, 0xFF, sizeof(font_pt->glyphs));
+        font_pt->font_address = font_address;
+    }
+    font_pt->last_used_stamp = ++sh1122_glyph_cache_stamp;
+    
+    _Static_assert(sizeof(font_pt->unicode_inters) == sizeof(oled_descriptor->current_unicode_inters), "Cached unicode intervals don't match the descriptor ones");
+    memcpy(&oled_descriptor->current_font_header, &font_pt->font_header, sizeof(oled_descriptor->current_font_header));
+    memcpy(&oled_descriptor->current_unicode_inters, &font_pt->unicode_inters, sizeof(oled_descriptor->current_unicode_inters));
+#else
+    custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_font_header, font_address, sizeof(oled_descriptor->current_font_header));
+    custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_unicode_inters, font_address + sizeof(oled_descriptor->current_font_header), sizeof(oled_descriptor->current_unicode_inters));
+#endif
+}
+
 /*! \fn     sh1122_set_emergency_font(void)
 *   \brief  Use the flash-stored emergency font (ascii only)
 *   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
 */
 void sh1122_set_emergency_font(oled_descriptor_t* oled_descriptor)
 {
-    oled_descriptor->currentFontAddress = CUSTOM_FS_EMERGENCY_FONT_FILE_ADDR;
-    custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_font_header, oled_descriptor->currentFontAddress, sizeof(oled_descriptor->current_font_header));
-    custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_unicode_inters, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header), sizeof(oled_descriptor->current_unicode_inters));
+    sh1122_load_font(oled_descriptor, CUSTOM_FS_EMERGENCY_FONT_FILE_ADDR);
 }
 
 /*! \fn     sh1122_refresh_used_font(oled_descriptor_t* oled_descriptor, uint16_t font_id)
@@ -852,11 +1098,8 @@ RET_TYPE sh1122_refresh_used_font(oled_descriptor_t* oled_descriptor, uint16_t f
     }
     else
     {
-        /* Read font header */
-        custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_font_header, oled_descriptor->currentFontAddress, sizeof(oled_descriptor->current_font_header));
-        
-        /* Read unicode chars support intervals */
-        custom_fs_read_from_flash((uint8_t*)&oled_descriptor->current_unicode_inters, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header), sizeof(oled_descriptor->current_unicode_inters));
+        /* Read font header & unicode chars support intervals */
+        sh1122_load_font(oled_descriptor, oled_descriptor->currentFontAddress);
         
         /* Check for ? support */
         if (('?' < oled_descriptor->current_unicode_inters[0].interval_start) || ('?' > oled_descriptor->current_unicode_inters[0].interval_end))
@@ -1009,6 +1252,7 @@ void sh1122_draw_vertical_line(oled_descriptor_t* oled_descriptor, int16_t x, in
             /* Fill frame buffer */
             oled_descriptor->frame_buffer[y][x/2] |= pixels;
         }
+        sh1122_mark_frame_buffer_dirty(oled_descriptor, x, ystart, 1, yend-ystart+1);
     } 
     else
     {
@@ -1079,6 +1323,16 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
         /* Previous pixels in case we are shifted */
         uint8_t prev_pixels = 0x00;
         
+        /* Update dirty area, the whole line when wrapping */
+        if ((x < 0) || (x + width > SH1122_OLED_WIDTH))
+        {
+            sh1122_mark_frame_buffer_dirty(oled_descriptor, 0, y, SH1122_OLED_WIDTH, 1);
+        }
+        else
+        {
+            sh1122_mark_frame_buffer_dirty(oled_descriptor, x, y, width, 1);
+        }
+        
         /* Boolean to mention if pixel to be written is the first one in the buffer */
         BOOL pixel_shift = FALSE;
         
@@ -1094,7 +1348,7 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
                 /* Check for 2 pixels alignment */
                 if ((x%2) == 0)
                 {
-                    memcpy(&oled_descriptor->frame_buffer[y][x/2+SH1122_OLED_WIDTH/2], pixels, (nb_pixels_to_be_written/2));
+                    oled_raster_copy(&oled_descriptor->frame_buffer[y][x/2+SH1122_OLED_WIDTH/2], pixels, (nb_pixels_to_be_written/2));
                     pixels -= x/2;
                 }
                 else
@@ -1102,13 +1356,9 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
                     /* We get pixel shift! */
                     pixel_shift = TRUE;
 
-                    /* Not 2 pixels aligned, loop */
-                    for (int16_t i = x; i < x+nb_pixels_to_be_written; i+=2)
-                    {
-                        oled_descriptor->frame_buffer[y][(i+SH1122_OLED_WIDTH)/2] = (*pixels >> 4) | (prev_pixels << 4);
-                        prev_pixels = *pixels;
-                        pixels++;
-                    }
+                    /* Not 2 pixels aligned, shift & merge */
+                    prev_pixels = oled_raster_copy_shifted(&oled_descriptor->frame_buffer[y][(x+SH1122_OLED_WIDTH)/2], pixels, (nb_pixels_to_be_written+1)/2, prev_pixels);
+                    pixels += (nb_pixels_to_be_written+1)/2;
                 }
                 
                 /* Did we miss the last pixel? */
@@ -1152,7 +1402,7 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
         /* Check for 2 pixels alignment */
         if ((x%2 == 0) && (pixel_shift == FALSE))
         {            
-            memcpy(&oled_descriptor->frame_buffer[y][x/2], pixels, nb_pixels_to_be_written/2);
+            oled_raster_copy(&oled_descriptor->frame_buffer[y][x/2], pixels, nb_pixels_to_be_written/2);
             pixels += nb_pixels_to_be_written/2;
         } 
         else
@@ -1160,13 +1410,9 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
             /* We get pixel shift! */
             pixel_shift = TRUE;
             
-            /* Not 2 pixels aligned, loop */
-            for (int16_t i = x; i < x+nb_pixels_to_be_written; i+=2)
-            {
-                oled_descriptor->frame_buffer[y][i/2] = (*pixels >> 4) | (prev_pixels << 4);
-                prev_pixels = *pixels;
-                pixels++;
-            }
+            /* Not 2 pixels aligned, shift & merge */
+            prev_pixels = oled_raster_copy_shifted(&oled_descriptor->frame_buffer[y][x/2], pixels, (nb_pixels_to_be_written+1)/2, prev_pixels);
+            pixels += (nb_pixels_to_be_written+1)/2;
         }
         
         /* Did we miss the last pixel? */
@@ -1199,18 +1445,14 @@ void sh1122_display_horizontal_pixel_line(oled_descriptor_t* oled_descriptor, in
             /* Check for 2 pixels alignment */
             if (pixel_shift == FALSE)
             {
-                memcpy(&oled_descriptor->frame_buffer[y][0], pixels, nb_pixels_to_be_written/2);
+                oled_raster_copy(&oled_descriptor->frame_buffer[y][0], pixels, nb_pixels_to_be_written/2);
                 pixels += nb_pixels_to_be_written/2;
             } 
             else
             {
-                /* Not 2 pixels aligned, loop */
-                for (int16_t i = 0; i < width; i+=2)
-                {
-                    oled_descriptor->frame_buffer[y][i/2] = (*pixels >> 4) | (prev_pixels << 4);
-                    prev_pixels = *pixels;
-                    pixels++;
-                }
+                /* Not 2 pixels aligned, shift & merge */
+                prev_pixels = oled_raster_copy_shifted(&oled_descriptor->frame_buffer[y][0], pixels, (width+1)/2, prev_pixels);
+                pixels += (width+1)/2;
             }
         
             /* Did we miss the last pixel? */
@@ -1270,6 +1512,7 @@ void sh1122_draw_rectangle(oled_descriptor_t* oled_descriptor, int16_t x, int16_
     #ifdef OLED_INTERNAL_FRAME_BUFFER
     if (write_to_buffer != FALSE)
     {
+        sh1122_mark_frame_buffer_dirty(oled_descriptor, x, y, width, height);
         for (uint16_t yind = 0; yind < height; yind++)
         {
             uint16_t xind = 0;
@@ -1285,17 +1528,17 @@ void sh1122_draw_rectangle(oled_descriptor_t* oled_descriptor, int16_t x, int16_
                 oled_descriptor->frame_buffer[y+yind][(x+xind)/2] |= color;
             }
             
-            /* Start x multiple of 2, start filling */
-            for (; xind < width; xind+=2)
+            /* Start x multiple of 2, bulk fill */
+            if (xind < width)
             {
-                if ((xind+2) <= width)
-                {
-                    oled_descriptor->frame_buffer[y+yind][(x+xind)/2] = color | (color << 4);
-                }
-                else
+                uint16_t nb_full_bytes = (width-xind)/2;
+                oled_raster_fill(&oled_descriptor->frame_buffer[y+yind][(x+xind)/2], (uint8_t)(color | (color << 4)), nb_full_bytes);
+                
+                /* Last lonely pixel */
+                if (((width-xind) & 0x01) != 0)
                 {
-                    oled_descriptor->frame_buffer[y+yind][(x+xind)/2] &= 0x0F;
-                    oled_descriptor->frame_buffer[y+yind][(x+xind)/2] |= color << 4;
+                    oled_descriptor->frame_buffer[y+yind][(x+xind)/2 + nb_full_bytes] &= 0x0F;
+                    oled_descriptor->frame_buffer[y+yind][(x+xind)/2 + nb_full_bytes] |= color << 4;
                 }
             }
         }
@@ -1500,17 +1743,35 @@ void sh1122_draw_image_from_bitstream(oled_descriptor_t* oled_descriptor, int16_
         pixel_buffer[bitstream->width/2] = 0;
 
         /* Wait for a possible ongoing previous flush */
-        sh1122_check_for_flush_and_terminate(oled_descriptor);
+        sh1122_wait_for_frame_buffer_availability(oled_descriptor);
+        
+        /* 2 pixels aligned & fully on screen: decode lines straight into the frame buffer */
+        BOOL decode_in_frame_buffer = FALSE;
+        if ((x >= 0) && (x%2 == 0) && (x + bitstream->width <= oled_descriptor->max_disp_x))
+        {
+            decode_in_frame_buffer = TRUE;
+            sh1122_mark_frame_buffer_dirty(oled_descriptor, x, y, bitstream->width, bitstream->height);
+        }
         
         /* Lines loop */
         for (int16_t i = 0; i < bitstream->height; i++)
         {            
-            bitstream_bitmap_array_read(bitstream, pixel_buffer, bitstream->width);
-            
             /* Check for on screen */
             if ((y+i >= oled_descriptor->min_disp_y) && (y+i < oled_descriptor->max_disp_y))
             {
-                sh1122_display_horizontal_pixel_line(oled_descriptor, x, y+i, bitstream->width, pixel_buffer, write_to_buffer);
+                if (decode_in_frame_buffer != FALSE)
+                {
+                    bitstream_bitmap_array_read(bitstream, &oled_descriptor->frame_buffer[y+i][x/2], bitstream->width);
+                }
+                else
+                {
+                    bitstream_bitmap_array_read(bitstream, pixel_buffer, bitstream->width);
+                    sh1122_display_horizontal_pixel_line(oled_descriptor, x, y+i, bitstream->width, pixel_buffer, write_to_buffer);
+                }
+            }
+            else
+            {
+                bitstream_bitmap_array_read(bitstream, pixel_buffer, bitstream->width);
             }
         }
         
@@ -1786,124 +2047,18 @@ uint16_t sh1122_get_string_width(oled_descriptor_t* oled_descriptor, const cust_
     return width;    
 }
 
-/*! \fn     sh1122_get_glyph_width(oled_descriptor_t* oled_descriptor, char ch, uint16_t* glyph_height)
-*   \brief  Return the width of the specified character in the current font
+/*! \fn     sh1122_get_glyph_from_flash(oled_descriptor_t* oled_descriptor, cust_char_t ch, font_glyph_t* glyph)
+*   \brief  Read the glyph header of a character in the current font
 *   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
 *   \param  ch                  Character
-*   \param  glyph_height        Where to store the glyph height (added bonus)
-*   \return width of the glyph
+*   \param  glyph               Where to store the glyph header
+*   \return Glyph index, 0xFFFF if the font can't display this char (not even as '?')
 */
-uint16_t sh1122_get_glyph_width(oled_descriptor_t* oled_descriptor, cust_char_t ch, uint16_t* glyph_height)
-{
-    uint16_t glyph_desc_pt_offset = 0;
-    uint16_t interval_start = 0;
-    font_glyph_t glyph;
-    uint16_t gind;
-    
-    /* Set default value */
-    *glyph_height = 0;
-    
-    /* Check that a font was actually chosen */
-    if (oled_descriptor->currentFontAddress != 0)
-    {
-        /* Check that support for this char is described */
-        BOOL char_support_described = FALSE;
-        for (uint16_t i=0; i < sizeof(oled_descriptor->current_unicode_inters)/sizeof(oled_descriptor->current_unicode_inters[0]); i++)
-        {
-            /* Check if char is within this interval */
-            if ((oled_descriptor->current_unicode_inters[i].interval_start != 0xFFFF) && (oled_descriptor->current_unicode_inters[i].interval_start <= ch) && (oled_descriptor->current_unicode_inters[i].interval_end >= ch))
-            {
-                interval_start = oled_descriptor->current_unicode_inters[i].interval_start;
-                char_support_described = TRUE;
-                break;
-            }
-            
-            /* Add offset to descriptor */
-            glyph_desc_pt_offset += oled_descriptor->current_unicode_inters[i].interval_end - oled_descriptor->current_unicode_inters[i].interval_start + 1;
-        }
-        
-        /* Support not described, check if we could switch with ? */
-        if (char_support_described == FALSE)
-        {
-            if (oled_descriptor->question_mark_support_described != FALSE)
-            {
-                interval_start = oled_descriptor->current_unicode_inters[0].interval_start;
-                glyph_desc_pt_offset = 0;
-                ch = '?';
-            } 
-            else
-            {
-                return 0;
-            }
-        }
-        
-        /* Convert character to glyph index */
-        custom_fs_read_from_flash((uint8_t*)&gind, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + glyph_desc_pt_offset*sizeof(gind) + (ch - interval_start)*sizeof(gind), sizeof(gind));
-
-        /* Check that we know this glyph */
-        if(gind == 0xFFFF)
-        {
-            // If we don't know this character, try again with '?'
-            if (oled_descriptor->question_mark_support_described == FALSE)
-            {
-                return 0;
-            }
-            else
-            {
-                ch = '?';
-            }            
-            custom_fs_read_from_flash((uint8_t*)&gind, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + glyph_desc_pt_offset*sizeof(gind) + (ch - interval_start)*sizeof(gind), sizeof(gind));
-            
-            // If we still don't know it, return 0
-            if (gind == 0xFFFF)
-            {
-                return 0;
-            }
-        }
-
-        // Read the beginning of the glyph
-        custom_fs_read_from_flash((uint8_t*)&glyph, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + (oled_descriptor->current_font_header.described_chr_count)*sizeof(gind) + gind*sizeof(glyph), sizeof(glyph));
-
-        if (glyph.glyph_data_offset == 0xFFFFFFFF)
-        {
-            // If there's no glyph data, it is the space!
-            return glyph.xrect + 1;
-        }
-        else
-        {
-            *glyph_height = glyph.yrect + glyph.yoffset;
-            return glyph.xrect + glyph.xoffset + 1;
-        }
-    }
-    else
-    {
-        return 0;
-    }
-}
-
- /*! \fn     sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, char ch, BOOL write_to_buffer)
- *   \brief  Draw a character glyph on the screen at x,y.
- *   \param  oled_descriptor    Pointer to a sh1122 descriptor struct
- *   \param  x                  x position to start glyph
- *   \param  y                  y position to start glyph
- *   \param  ch                 Character to draw
- *   \param  write_to_buffer    Set to true to write to internal buffer
- *   \return width of the glyph
- */
-uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, cust_char_t ch, BOOL write_to_buffer)
+static uint16_t sh1122_get_glyph_from_flash(oled_descriptor_t* oled_descriptor, cust_char_t ch, font_glyph_t* glyph)
 {
     uint16_t glyph_desc_pt_offset = 0;  // Offset to the pointer of the glyph descriptor
     uint16_t interval_start = 0;        // Unicode code of the first char of the current unicode support interval
-    bitstream_bitmap_t bs;              // Character bitstream
-    uint8_t glyph_width;                // Glyph width
-    font_glyph_t glyph;                 // Glyph header
     uint16_t gind;                      // Glyph index
-
-    /* Check for selected font */
-    if (oled_descriptor->currentFontAddress == 0)
-    {
-        return 0;
-    }
     
     /* Check that support for this char is described */
     BOOL char_support_described = FALSE;
@@ -1932,7 +2087,7 @@ uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_
         }
         else
         {
-            return 0;
+            return 0xFFFF;
         }
     }
     
@@ -1945,7 +2100,7 @@ uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_
         // If we don't know this character, try again with '?'
         if (oled_descriptor->question_mark_support_described == FALSE)
         {
-            return 0;
+            return 0xFFFF;
         }
         else
         {
@@ -1953,15 +2108,118 @@ uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_
         }
         custom_fs_read_from_flash((uint8_t*)&gind, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + glyph_desc_pt_offset*sizeof(gind) + (ch - interval_start)*sizeof(gind), sizeof(gind));
         
-        // If we still don't know it, return 0
+        // If we still don't know it, return
         if (gind == 0xFFFF)
         {
-            return 0;
+            return 0xFFFF;
         }
     }
     
-    /* Read glyph data */
-    custom_fs_read_from_flash((uint8_t*)&glyph, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + (oled_descriptor->current_font_header.described_chr_count)*sizeof(gind) + gind*sizeof(glyph), sizeof(glyph));
+    /* Read glyph header */
+    custom_fs_read_from_flash((uint8_t*)glyph, oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + (oled_descriptor->current_font_header.described_chr_count)*sizeof(gind) + gind*sizeof(*glyph), sizeof(*glyph));
+    return gind;
+}
+
+/*! \fn     sh1122_get_glyph(oled_descriptor_t* oled_descriptor, cust_char_t ch, font_glyph_t* glyph)
+*   \brief  Get the glyph header of a character in the current font, from the glyph cache when possible
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*   \param  ch                  Character
+*   \param  glyph               Where to store the glyph header
+*   \return RETURN_OK if the font can display this char (possibly as '?')
+*/
+static RET_TYPE sh1122_get_glyph(oled_descriptor_t* oled_descriptor, cust_char_t ch, font_glyph_t* glyph)
+{
+    uint16_t gind;
+    
+#if SH1122_GLYPH_CACHE_NB_FONTS > 0
+    sh1122_cached_glyph_t* cached_glyph_pt = 0;
+    
+    /* Find the current font in the cache: it was put there when loaded, unless evicted since */
+    for (uint16_t i = 0; i < SH1122_GLYPH_CACHE_NB_FONTS; i++)
+    {
+        if (sh1122_glyph_cache_fonts[i].font_address == oled_descriptor->currentFontAddress)
+        {
+            cached_glyph_pt = &sh1122_glyph_cache_fonts[i].glyphs[ch & (SH1122_GLYPH_CACHE_NB_GLYPHS-1)];
+            break;
+        }
+    }
+    
+    /* Hit (0xFFFF marks empty entries) */
+    if ((cached_glyph_pt != 0) && (cached_glyph_pt->ch == ch) && (ch != 0xFFFF))
+    {
+        sh1122_glyph_cache_stats.nb_hits++;
+        *glyph = cached_glyph_pt->glyph;
+        return (cached_glyph_pt->gind == 0xFFFF)? RETURN_NOK : RETURN_OK;
+    }
+    sh1122_glyph_cache_stats.nb_misses++;
+    
+    /* Miss: fetch glyph and replace whatever was cached for this slot */
+    gind = sh1122_get_glyph_from_flash(oled_descriptor, ch, glyph);
+    if (cached_glyph_pt != 0)
+    {
+        cached_glyph_pt->ch = ch;
+        cached_glyph_pt->gind = gind;
+        cached_glyph_pt->glyph = *glyph;
+    }
+#else
+    gind = sh1122_get_glyph_from_flash(oled_descriptor, ch, glyph);
+#endif
+
+    return (gind == 0xFFFF)? RETURN_NOK : RETURN_OK;
+}
+
+/*! \fn     sh1122_get_glyph_width(oled_descriptor_t* oled_descriptor, char ch, uint16_t* glyph_height)
+*   \brief  Return the width of the specified character in the current font
+*   \param  oled_descriptor     Pointer to a sh1122 descriptor struct
+*   \param  ch                  Character
+*   \param  glyph_height        Where to store the glyph height (added bonus)
+*   \return width of the glyph
+*/
+uint16_t sh1122_get_glyph_width(oled_descriptor_t* oled_descriptor, cust_char_t ch, uint16_t* glyph_height)
+{
+    font_glyph_t glyph;
+    
+    /* Set default value */
+    *glyph_height = 0;
+    
+    /* Check that a font was actually chosen and that it can display this char */
+    if ((oled_descriptor->currentFontAddress == 0) || (sh1122_get_glyph(oled_descriptor, ch, &glyph) != RETURN_OK))
+    {
+        return 0;
+    }
+
+    if (glyph.glyph_data_offset == 0xFFFFFFFF)
+    {
+        // If there's no glyph data, it is the space!
+        return glyph.xrect + 1;
+    }
+    else
+    {
+        *glyph_height = glyph.yrect + glyph.yoffset;
+        return glyph.xrect + glyph.xoffset + 1;
+    }
+}
+
+ /*! \fn     sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, char ch, BOOL write_to_buffer)
+ *   \brief  Draw a character glyph on the screen at x,y.
+ *   \param  oled_descriptor    Pointer to a sh1122 descriptor struct
+ *   \param  x                  x position to start glyph
+ *   \param  y                  y position to start glyph
+ *   \param  ch                 Character to draw
+ *   \param  write_to_buffer    Set to true to write to internal buffer
+ *   \return width of the glyph
+ */
+uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_t y, cust_char_t ch, BOOL write_to_buffer)
+{
+    bitstream_bitmap_t bs;              // Character bitstream
+    uint8_t glyph_width;                // Glyph width
+    font_glyph_t glyph;                 // Glyph header
+
+    /* Check for selected font and that it can display this char */
+    if ((oled_descriptor->currentFontAddress == 0) || (sh1122_get_glyph(oled_descriptor, ch, &glyph) != RETURN_OK))
+    {
+        return 0;
+    }
 
     if (glyph.glyph_data_offset == 0xFFFFFFFF)
     {
@@ -1977,7 +2235,7 @@ uint16_t sh1122_glyph_draw(oled_descriptor_t* oled_descriptor, int16_t x, int16_
         y += glyph.yoffset;
         
         /* Compute glyph data address */
-        custom_fs_address_t gaddr = oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + (oled_descriptor->current_font_header.described_chr_count)*sizeof(gind) + (oled_descriptor->current_font_header.chr_count)*sizeof(glyph) + glyph.glyph_data_offset;
+        custom_fs_address_t gaddr = oled_descriptor->currentFontAddress + sizeof(oled_descriptor->current_font_header) + sizeof(oled_descriptor->current_unicode_inters) + (oled_descriptor->current_font_header.described_chr_count)*sizeof(uint16_t) + (oled_descriptor->current_font_header.chr_count)*sizeof(glyph) + glyph.glyph_data_offset;
         
         // Initialize bitstream & draw the character
         bitstream_glyph_bitmap_init(&bs, &oled_descriptor->current_font_header, &glyph, gaddr, TRUE);
@@ -67,6 +67,19 @@
 /* Transition defines */
 #define SH1122_TRANSITION_PIXEL     0x03
 
+/* Glyph cache: number of fonts kept (set to 0 to disable) and glyph metrics per font, direct mapped on the unicode point (power of 2) */
+/* RAM: 76B per font + 12B per glyph, 844B with the default 1 font & 64 glyphs (with 32 glyphs, upper & lower case letters share entries) */
+#ifndef SH1122_GLYPH_CACHE_NB_FONTS
+    #ifdef BOOTLOADER
+        #define SH1122_GLYPH_CACHE_NB_FONTS 0
+    #else
+        #define SH1122_GLYPH_CACHE_NB_FONTS 1
+    #endif
+#endif
+#ifndef SH1122_GLYPH_CACHE_NB_GLYPHS
+    #define SH1122_GLYPH_CACHE_NB_GLYPHS    64
+#endif
+
 /* Enums */
 typedef enum {OLED_TRANS_NONE, OLED_LEFT_RIGHT_TRANS, OLED_RIGHT_LEFT_TRANS, OLED_TOP_BOT_TRANS, OLED_BOT_TOP_TRANS, OLED_IN_OUT_TRANS, OLED_OUT_IN_TRANS} oled_transition_te;
 typedef enum {OLED_SCROLL_NONE = 0, OLED_SCROLL_UP = 1, OLED_SCROLL_DOWN = 2, OLED_SCROLL_FLIP = 3} oled_scroll_te;
@@ -87,6 +100,12 @@ typedef struct
     uint8_t pixels;
 } gddram_px_t;
 
+typedef struct
+{
+    uint32_t nb_hits;
+    uint32_t nb_misses;
+} sh1122_glyph_cache_stats_t;
+
 typedef struct
 {
     Sercom* sercom_pt;
@@ -120,6 +139,14 @@ typedef struct
     #ifdef OLED_INTERNAL_FRAME_BUFFER
     uint8_t frame_buffer[SH1122_OLED_HEIGHT][SH1122_OLED_WIDTH/(8/SH1122_OLED_BPP)];
     BOOL frame_buffer_flush_in_progress;
+    #ifdef OLED_DOUBLE_FRAME_BUFFER
+    uint8_t dma_frame_buffer[SH1122_OLED_HEIGHT][SH1122_OLED_WIDTH/(8/SH1122_OLED_BPP)];    // Frame buffer copy DMA flushes are sent from
+    #endif
+    BOOL frame_buffer_full_flush_needed;                // Screen was written outside of the frame buffer
+    int16_t dirty_x_start;                              // Frame buffer dirty area, flushed by sh1122_flush_frame_buffer()
+    int16_t dirty_x_end;                                // Dirty area end X (exclusive)
+    int16_t dirty_y_start;                              // Dirty area start Y, empty area when dirty_y_start >= dirty_y_end
+    int16_t dirty_y_end;                                // Dirty area end Y (exclusive)
     #endif
 } oled_descriptor_t;
 
@@ -173,6 +200,7 @@ void sh1122_allow_partial_text_x_draw(oled_descriptor_t* oled_descriptor);
 void sh1122_set_max_text_x(oled_descriptor_t* oled_descriptor, int16_t x);
 void sh1122_set_min_text_x(oled_descriptor_t* oled_descriptor, int16_t x);
 void sh1122_clear_current_screen(oled_descriptor_t* oled_descriptor);
+void sh1122_get_glyph_cache_stats(sh1122_glyph_cache_stats_t* stats);
 void sh1122_reset_lim_display_y(oled_descriptor_t* oled_descriptor);
 void sh1122_set_emergency_font(oled_descriptor_t* oled_descriptor);
 void sh1122_start_data_sending(oled_descriptor_t* oled_descriptor);
@@ -191,7 +219,9 @@ void sh1122_oled_on(oled_descriptor_t* oled_descriptor);
     void sh1122_flush_frame_buffer_window(oled_descriptor_t* oled_descriptor, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
     void sh1122_flush_frame_buffer_y_window(oled_descriptor_t* oled_descriptor, uint16_t ystart, uint16_t yend);
     void sh1122_clear_y_frame_buffer(oled_descriptor_t* oled_descriptor, uint16_t ystart, uint16_t yend);
+    void sh1122_wait_for_frame_buffer_availability(oled_descriptor_t* oled_descriptor);
     void sh1122_check_for_flush_and_terminate(oled_descriptor_t* oled_descriptor);
+    void sh1122_set_frame_buffer_dirty(oled_descriptor_t* oled_descriptor);
     void sh1122_flush_frame_buffer(oled_descriptor_t* oled_descriptor);
     void sh1122_clear_frame_buffer(oled_descriptor_t* oled_descriptor);
 #endif
@@ -28,6 +28,7 @@
 #include "custom_bitstream.h"
 #include "driver_sercom.h"
 #include "driver_timer.h"
+#include "oled_raster.h"
 #include "custom_fs.h"
 #include "ssd1363.h"
 #include "dma.h"
@@ -523,7 +524,7 @@ void ssd1363_clear_current_screen(oled_descriptor_t* oled_descriptor)
 void ssd1363_clear_frame_buffer(oled_descriptor_t* oled_descriptor)
 {
     ssd1363_check_for_flush_and_terminate(oled_descriptor);
-    memset((void*)oled_descriptor->frame_buffer, 0x00, sizeof(oled_descriptor->frame_buffer));
+    oled_raster_fill(&oled_descriptor->frame_buffer[0][0], 0x00, sizeof(oled_descriptor->frame_buffer));
 }
 
 /*! \fn     ssd1363_check_for_flush_and_terminate(oled_descriptor_t* oled_descriptor)
@@ -1026,14 +1027,15 @@ void ssd1363_draw_rectangle(oled_descriptor_t* oled_descriptor, int16_t x, int16
                 oled_descriptor->frame_buffer_16b[y+yind][x/SSD1363_OLED_PIX_PER_COL] |= (pixel_lfilling[xoffset] & pixels_4_color);
             }
             
-            /* Start x multiple of 4, start filling */
-            for (; xind < width; xind+=SSD1363_OLED_PIX_PER_COL)
+            /* Start x multiple of 4, bulk fill */
+            if (xind < width)
             {
-                if ((xind+SSD1363_OLED_PIX_PER_COL) <= width)
-                {
-                    oled_descriptor->frame_buffer_16b[y+yind][(x+xind)/SSD1363_OLED_PIX_PER_COL] = pixels_4_color;
-                }
-                else
+                uint16_t nb_full_words = (width-xind)/SSD1363_OLED_PIX_PER_COL;
+                oled_raster_fill((uint8_t*)&oled_descriptor->frame_buffer_16b[y+yind][(x+xind)/SSD1363_OLED_PIX_PER_COL], (uint8_t)pixels_4_color, nb_full_words*2);
+                xind += nb_full_words*SSD1363_OLED_PIX_PER_COL;
+                
+                /* Last 1 to 3 pixels */
+                if (xind < width)
                 {
                     oled_descriptor->frame_buffer_16b[y+yind][(x+xind)/SSD1363_OLED_PIX_PER_COL] &= ~pixel_rfilling[width-xind];
                     oled_descriptor->frame_buffer_16b[y+yind][(x+xind)/SSD1363_OLED_PIX_PER_COL] |= (pixel_rfilling[width-xind]& pixels_4_color);
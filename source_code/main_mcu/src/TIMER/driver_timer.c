@@ -904,7 +904,17 @@ void timer_delay_ms(uint32_t ms)
 {
 #ifndef BOOTLOADER
     timer_start_timer(TIMER_WAITING_FUNCT, ms+1);
+#ifdef EMULATOR_BUILD
+    /* Virtual time: nothing else happens until the timer expires, jump to its deadline */
+    emu_skip_time_ms(ms+1);
+    while(timer_has_timer_expired(TIMER_WAITING_FUNCT, TRUE) != TIMER_EXPIRED)
+    {
+        /* Sleep until the next tick rather than spinning */
+        emu_idle_wait();
+    }
+#else
     while(timer_has_timer_expired(TIMER_WAITING_FUNCT, TRUE) != TIMER_EXPIRED);
+#endif
 #else
     DELAYMS(ms);
 #endif
@@ -522,6 +522,8 @@ typedef struct
 #ifndef BOOTLOADER
     #define OLED_INTERNAL_FRAME_BUFFER
 #endif
+/* Send OLED DMA flushes from a copy of the frame buffer, allowing drawing during flushes (costs another frame buffer in RAM) */
+//#define OLED_DOUBLE_FRAME_BUFFER
 /* allow printf for the screen */
 //#define OLED_PRINTF_ENABLED
 /* Allow debug USB commands */
@@ -1422,6 +1424,11 @@ typedef struct
 #if defined(EMULATOR_BUILD)
     #undef FLASH_DMA_FETCHES
     #undef OLED_DMA_TRANSFER
+    #undef OLED_DOUBLE_FRAME_BUFFER
+#endif
+
+#if defined(OLED_DOUBLE_FRAME_BUFFER) && (!defined(OLED_DMA_TRANSFER) || !defined(OLED_INTERNAL_FRAME_BUFFER))
+    #error "OLED_DOUBLE_FRAME_BUFFER requires OLED_DMA_TRANSFER and OLED_INTERNAL_FRAME_BUFFER"
 #endif
 
 